@@ -51,6 +51,7 @@ pub(crate) fn dreamcast_ptr() -> *mut Dreamcast {
 
 fn peripheral_hook(_ctx: *mut sh4_core::Sh4Ctx, cycles: u32) {
     spg::tick(cycles);
+    pvr::tick_render(cycles);
 
     if cycles == 0 {
         return;
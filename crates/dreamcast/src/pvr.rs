@@ -1,5 +1,11 @@
 use once_cell::sync::Lazy;
-use std::{ptr, sync::Mutex};
+use std::{
+    ptr,
+    sync::{
+        atomic::{AtomicU32, Ordering},
+        Mutex,
+    },
+};
 
 use crate::{
     asic, dreamcast_ptr, refsw2, spg,
@@ -70,6 +76,38 @@ impl Default for PvrState {
 
 static PVR_STATE: Lazy<Mutex<PvrState>> = Lazy::new(|| Mutex::new(PvrState::default()));
 
+// SH4 cycles from STARTRENDER to RENDER_DONE, about a millisecond. Fixed, so that the interrupt
+// timing doesn't depend on how fast the host renders
+const RENDER_DONE_CYCLES: u32 = 200_000_000 / 1000;
+
+// SH4 cycles until the frame started by STARTRENDER signals RENDER_DONE, 0 if none is pending
+static RENDER_CYCLES_LEFT: AtomicU32 = AtomicU32::new(0);
+
+fn raise_render_done() {
+    asic::raise_normal(RENDER_DONE_INTERRUPT_BIT);
+    asic::raise_normal(RENDER_DONE_ISP_INTERRUPT_BIT);
+    asic::raise_normal(RENDER_DONE_VD_INTERRUPT_BIT);
+}
+
+/// Raise RENDER_DONE once RENDER_DONE_CYCLES have passed since STARTRENDER, waiting for the
+/// frame being rendered in the background if it isn't done yet.
+/// Called with the elapsed SH4 cycles from the peripheral hook.
+pub fn tick_render(cycles: u32) {
+    let left = RENDER_CYCLES_LEFT.load(Ordering::Relaxed);
+    if left == 0 {
+        return;
+    }
+
+    if cycles < left {
+        RENDER_CYCLES_LEFT.store(left - cycles, Ordering::Relaxed);
+        return;
+    }
+
+    RENDER_CYCLES_LEFT.store(0, Ordering::Relaxed);
+    refsw2::refsw2_render_wait();
+    raise_render_done();
+}
+
 pub fn handles_address(addr: u32) -> bool {
     (PVR_BASE_ADDR..=PVR_BASE_ADDR + PVR_REG_MASK as u32).contains(&addr)
 }
@@ -123,17 +161,19 @@ pub fn write(addr: u32, size: usize, value: u32) {
             x if x == TA_YUV_TEX_CNT_ADDR as usize => {}
             x if x == STARTRENDER_ADDR as usize => {
                 println!("PVR: STARTRENDER write (value=0x{value:08X})");
-                refsw2::refsw2_render(
+                // CORE renders one frame at a time
+                if RENDER_CYCLES_LEFT.swap(0, Ordering::Relaxed) != 0 {
+                    refsw2::refsw2_render_wait();
+                    raise_render_done();
+                }
+                refsw2::refsw2_render_async(
                     dreamcast_mut()
                         .expect("Dreamcast instance not initialised")
                         .video_ram
                         .as_mut_ptr(),
                     state.regs.as_ptr(),
                 );
-                // TODO: Hook up renderer start when available.
-                asic::raise_normal(RENDER_DONE_INTERRUPT_BIT);
-                asic::raise_normal(RENDER_DONE_ISP_INTERRUPT_BIT);
-                asic::raise_normal(RENDER_DONE_VD_INTERRUPT_BIT);
+                RENDER_CYCLES_LEFT.store(RENDER_DONE_CYCLES, Ordering::Relaxed);
             }
             x if x == TA_LIST_INIT_ADDR as usize => {
                 state.regs[x / 4] = value;
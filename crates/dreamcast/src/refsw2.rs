@@ -5,17 +5,63 @@
     - "refsw2-cpp": Use C++ FFI backend (refsw2-cpp crate)
     - "refsw2-rust": Use pure Rust backend (refsw2-rust crate) - default
     - Neither: Stub implementation (no rendering)
+
+    refsw2_render_async starts a frame and refsw2_render_poll returns true once it is done and
+    written to VRAM. Backends without background rendering finish the frame in refsw2_render_async.
 */
 
 // C++ backend (via FFI)
 #[cfg(feature = "refsw2-cpp")]
 mod cpp_backend {
+    use std::sync::atomic::{AtomicPtr, Ordering};
+
+    // Renderer instance used for asynchronous rendering, created on first use
+    static CONTEXT: AtomicPtr<refsw2_cpp::RefswContext> = AtomicPtr::new(std::ptr::null_mut());
+
+    fn context() -> *mut refsw2_cpp::RefswContext {
+        let ctx = CONTEXT.load(Ordering::Acquire);
+        if !ctx.is_null() {
+            return ctx;
+        }
+
+        // Another caller may have created one meanwhile, in which case ours is destroyed
+        let ctx = unsafe { refsw2_cpp::create_context() };
+        match CONTEXT.compare_exchange(
+            std::ptr::null_mut(),
+            ctx,
+            Ordering::AcqRel,
+            Ordering::Acquire,
+        ) {
+            Ok(_) => ctx,
+            Err(winner) => {
+                unsafe { refsw2_cpp::destroy_context(ctx) };
+                winner
+            }
+        }
+    }
+
     pub fn refsw2_render(vram: *mut u8, regs: *const u32) {
         unsafe {
             refsw2_cpp::render(vram, regs);
         }
     }
 
+    pub fn refsw2_render_async(vram: *mut u8, regs: *const u32) {
+        unsafe {
+            refsw2_cpp::render_async(context(), vram, regs);
+        }
+    }
+
+    pub fn refsw2_render_poll() -> bool {
+        unsafe { refsw2_cpp::render_poll(context()) }
+    }
+
+    pub fn refsw2_render_wait() {
+        unsafe {
+            refsw2_cpp::render_wait(context());
+        }
+    }
+
     pub fn refsw2_init() {
         unsafe {
             refsw2_cpp::init();
@@ -32,6 +78,16 @@ mod rust_backend {
         }
     }
 
+    pub fn refsw2_render_async(vram: *mut u8, regs: *const u32) {
+        refsw2_render(vram, regs);
+    }
+
+    pub fn refsw2_render_poll() -> bool {
+        true
+    }
+
+    pub fn refsw2_render_wait() {}
+
     pub fn refsw2_init() {
         unsafe {
             refsw2_rust::init();
@@ -46,6 +102,16 @@ mod stub_backend {
         // No-op
     }
 
+    pub fn refsw2_render_async(_vram: *mut u8, _regs: *const u32) {
+        // No-op
+    }
+
+    pub fn refsw2_render_poll() -> bool {
+        true
+    }
+
+    pub fn refsw2_render_wait() {}
+
     pub fn refsw2_init() {
         // No-op
     }
@@ -53,10 +119,16 @@ mod stub_backend {
 
 // Export the selected backend
 #[cfg(feature = "refsw2-cpp")]
-pub use cpp_backend::{refsw2_init, refsw2_render};
+pub use cpp_backend::{
+    refsw2_init, refsw2_render, refsw2_render_async, refsw2_render_poll, refsw2_render_wait,
+};
 
 #[cfg(feature = "refsw2-rust")]
-pub use rust_backend::{refsw2_init, refsw2_render};
+pub use rust_backend::{
+    refsw2_init, refsw2_render, refsw2_render_async, refsw2_render_poll, refsw2_render_wait,
+};
 
 #[cfg(not(any(feature = "refsw2-cpp", feature = "refsw2-rust")))]
-pub use stub_backend::{refsw2_init, refsw2_render};
+pub use stub_backend::{
+    refsw2_init, refsw2_render, refsw2_render_async, refsw2_render_poll, refsw2_render_wait,
+};
@@ -1,6 +1,7 @@
 fn main() {
     // Build C++ backend
-    cc::Build::new()
+    let mut build = cc::Build::new();
+    build
         .cpp(true)
         .file("ffi/refsw2_stub.cc")
         .file("ffi/refsw_lists.cc")
@@ -10,7 +11,17 @@ fn main() {
         .flag_if_supported("/std:c++20")
         .flag_if_supported("-O3")
         .flag_if_supported("/O2")
-        .compile("refsw2_cpp");
+        // The rasterizer relies on the edge functions evaluating the same way everywhere
+        .flag_if_supported("-ffp-contract=off")
+        .flag_if_supported("/fp:precise")
+        // Buffers are reinterpreted through casts
+        .flag_if_supported("-fno-strict-aliasing");
+
+    if std::env::var_os("CARGO_FEATURE_VERIFY_TSP").is_some() {
+        build.define("REFSW_VERIFY_TSP", None);
+    }
+
+    build.compile("refsw2_cpp");
 
     println!("cargo:rerun-if-changed=ffi/");
 }
@@ -318,6 +318,326 @@ PixelFlush_tsp_fp PixelFlush_tsp_table[2][2][2][2][4][2] =
         },
     }
 ;
+PixelFlush_tspSpan_fp PixelFlush_tspSpan_table[2][2][2][2][4][2] =
+    {
+        {
+            {
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 0, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 1, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 2, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 3, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 0, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 1, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 2, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 3, 0>,
+                            &PixelFlush_tspSpan<0, 0, 0, 1, 3, 1>,
+                        },
+                    },
+                },
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 0, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 1, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 2, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 3, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 0, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 1, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 2, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 3, 0>,
+                            &PixelFlush_tspSpan<0, 0, 1, 1, 3, 1>,
+                        },
+                    },
+                },
+            },
+            {
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 0, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 1, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 2, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 3, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 0, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 1, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 2, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 3, 0>,
+                            &PixelFlush_tspSpan<0, 1, 0, 1, 3, 1>,
+                        },
+                    },
+                },
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 0, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 1, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 2, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 3, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 0, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 1, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 2, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 3, 0>,
+                            &PixelFlush_tspSpan<0, 1, 1, 1, 3, 1>,
+                        },
+                    },
+                },
+            },
+        },
+        {
+            {
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 0, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 1, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 2, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 3, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 0, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 1, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 2, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 3, 0>,
+                            &PixelFlush_tspSpan<1, 0, 0, 1, 3, 1>,
+                        },
+                    },
+                },
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 0, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 1, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 2, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 3, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 0, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 1, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 2, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 3, 0>,
+                            &PixelFlush_tspSpan<1, 0, 1, 1, 3, 1>,
+                        },
+                    },
+                },
+            },
+            {
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 0, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 1, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 2, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 3, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 0, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 1, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 2, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 3, 0>,
+                            &PixelFlush_tspSpan<1, 1, 0, 1, 3, 1>,
+                        },
+                    },
+                },
+                {
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 0, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 1, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 2, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 3, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 0, 3, 1>,
+                        },
+                    },
+                    {
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 0, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 0, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 1, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 1, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 2, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 2, 1>,
+                        },
+                        {
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 3, 0>,
+                            &PixelFlush_tspSpan<1, 1, 1, 1, 3, 1>,
+                        },
+                    },
+                },
+            },
+        },
+    }
+;
 TextureFilter_fp TextureFilter_table[2][2][2][2][2][4] =
     {
         {
@@ -1902,3 +2222,755 @@ TextureFetch_fp TextureFetch_table[2][2][2][2][8] =
         },
     }
 ;
+RasterizeTriangle_fp RasterizeTriangle_table[7][8][2][2] =
+    {
+        {
+            {
+                {
+                    &RasterizeTriangle<0, 0, 0, 0>,
+                    &RasterizeTriangle<0, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 0, 1, 0>,
+                    &RasterizeTriangle<0, 0, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<0, 1, 0, 0>,
+                    &RasterizeTriangle<0, 1, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 1, 1, 0>,
+                    &RasterizeTriangle<0, 1, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<0, 2, 0, 0>,
+                    &RasterizeTriangle<0, 2, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 2, 1, 0>,
+                    &RasterizeTriangle<0, 2, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<0, 3, 0, 0>,
+                    &RasterizeTriangle<0, 3, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 3, 1, 0>,
+                    &RasterizeTriangle<0, 3, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<0, 4, 0, 0>,
+                    &RasterizeTriangle<0, 4, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 4, 1, 0>,
+                    &RasterizeTriangle<0, 4, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<0, 5, 0, 0>,
+                    &RasterizeTriangle<0, 5, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 5, 1, 0>,
+                    &RasterizeTriangle<0, 5, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<0, 6, 0, 0>,
+                    &RasterizeTriangle<0, 6, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 6, 1, 0>,
+                    &RasterizeTriangle<0, 6, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<0, 7, 0, 0>,
+                    &RasterizeTriangle<0, 7, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<0, 7, 1, 0>,
+                    &RasterizeTriangle<0, 7, 1, 1>,
+                },
+            },
+        },
+        {
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<1, 0, 0, 0>,
+                    &RasterizeTriangle<1, 0, 0, 1>,
+                },
+            },
+        },
+        {
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<2, 0, 0, 0>,
+                    &RasterizeTriangle<2, 0, 0, 1>,
+                },
+            },
+        },
+        {
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<3, 0, 0, 0>,
+                    &RasterizeTriangle<3, 0, 0, 1>,
+                },
+            },
+        },
+        {
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<4, 0, 0, 0>,
+                    &RasterizeTriangle<4, 0, 0, 1>,
+                },
+            },
+        },
+        {
+            {
+                {
+                    &RasterizeTriangle<5, 0, 0, 0>,
+                    &RasterizeTriangle<5, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 0, 1, 0>,
+                    &RasterizeTriangle<5, 0, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<5, 1, 0, 0>,
+                    &RasterizeTriangle<5, 1, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 1, 1, 0>,
+                    &RasterizeTriangle<5, 1, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<5, 2, 0, 0>,
+                    &RasterizeTriangle<5, 2, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 2, 1, 0>,
+                    &RasterizeTriangle<5, 2, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<5, 3, 0, 0>,
+                    &RasterizeTriangle<5, 3, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 3, 1, 0>,
+                    &RasterizeTriangle<5, 3, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<5, 4, 0, 0>,
+                    &RasterizeTriangle<5, 4, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 4, 1, 0>,
+                    &RasterizeTriangle<5, 4, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<5, 5, 0, 0>,
+                    &RasterizeTriangle<5, 5, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 5, 1, 0>,
+                    &RasterizeTriangle<5, 5, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<5, 6, 0, 0>,
+                    &RasterizeTriangle<5, 6, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 6, 1, 0>,
+                    &RasterizeTriangle<5, 6, 1, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<5, 7, 0, 0>,
+                    &RasterizeTriangle<5, 7, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<5, 7, 1, 0>,
+                    &RasterizeTriangle<5, 7, 1, 1>,
+                },
+            },
+        },
+        {
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+            {
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+                {
+                    &RasterizeTriangle<6, 0, 0, 0>,
+                    &RasterizeTriangle<6, 0, 0, 1>,
+                },
+            },
+        },
+    }
+;
+RasterizeStrip_fp RasterizeStrip_table[5][8][2] =
+    {
+        {
+            {
+                &RasterizeStrip<0, 0, 0>,
+                &RasterizeStrip<0, 0, 1>,
+            },
+            {
+                &RasterizeStrip<0, 1, 0>,
+                &RasterizeStrip<0, 1, 1>,
+            },
+            {
+                &RasterizeStrip<0, 2, 0>,
+                &RasterizeStrip<0, 2, 1>,
+            },
+            {
+                &RasterizeStrip<0, 3, 0>,
+                &RasterizeStrip<0, 3, 1>,
+            },
+            {
+                &RasterizeStrip<0, 4, 0>,
+                &RasterizeStrip<0, 4, 1>,
+            },
+            {
+                &RasterizeStrip<0, 5, 0>,
+                &RasterizeStrip<0, 5, 1>,
+            },
+            {
+                &RasterizeStrip<0, 6, 0>,
+                &RasterizeStrip<0, 6, 1>,
+            },
+            {
+                &RasterizeStrip<0, 7, 0>,
+                &RasterizeStrip<0, 7, 1>,
+            },
+        },
+        {
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+            {
+                &RasterizeStrip<1, 0, 0>,
+                &RasterizeStrip<1, 0, 0>,
+            },
+        },
+        {
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+            {
+                &RasterizeStrip<2, 0, 0>,
+                &RasterizeStrip<2, 0, 0>,
+            },
+        },
+        {
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+            {
+                &RasterizeStrip<3, 0, 0>,
+                &RasterizeStrip<3, 0, 0>,
+            },
+        },
+        {
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+            {
+                &RasterizeStrip<4, 0, 0>,
+                &RasterizeStrip<4, 0, 0>,
+            },
+        },
+    }
+;
@@ -1,10 +1,12 @@
 #!/usr/bin/env python3
 import itertools
 
-def generate_table(name, parameters):
+def generate_table(name, parameters, template_args=None):
     """
     Generates C++ code for PixelFlush_tsp_table given parameter ranges.
     :param parameters: tuple of ints, the range for each template parameter
+    :param template_args: optional function mapping table indices to template arguments,
+                          so entries that behave the same can share an instantiation
     :return: string containing the C++ table declaration and initializer
     """
     num_params = len(parameters)
@@ -16,7 +18,8 @@ def generate_table(name, parameters):
     def recurse(level, indices, indent):
         if level == num_params:
             # Leaf: generate function pointer
-            params_list = ', '.join(str(i) for i in indices)
+            args = template_args(*indices) if template_args else indices
+            params_list = ', '.join(str(i) for i in args)
             lines.append(f"{indent}&{name}<{params_list}>,")
         else:
             # Open brace for this dimension
@@ -50,6 +53,9 @@ if __name__ == '__main__':
     code = generate_table("PixelFlush_tsp", tuple(1 << bw for bw in bitwidths))
     print(code)
 
+    code = generate_table("PixelFlush_tspSpan", tuple(1 << bw for bw in bitwidths))
+    print(code)
+
     bitwidths = (
         1, # [entry->params.tsp[two_voume_index].IgnoreTexA]
         1, # [entry->params.tsp[two_voume_index].ClampU]
@@ -87,4 +93,28 @@ if __name__ == '__main__':
         3, # [entry->params.tcw[two_voume_index].PixelFmt]
     )
     code = generate_table("TextureFetch", tuple(1 << bw for bw in bitwidths))
+    print(code)
+
+    ranges = (
+        7,      # [render_mode], RM_OPAQUE .. RM_MODIFIER
+        1 << 3, # [params->isp.DepthMode]
+        1 << 1, # [params->isp.ZWriteDis]
+        1 << 1, # [v4 != nullptr]
+    )
+    def rasterizer_args(render_mode, depth_mode, zwrite_dis, quad):
+        # Only RM_OPAQUE and RM_TRANSLUCENT_PRESORT use the ISP depth mode and z write disable
+        if render_mode not in (0, 5):
+            depth_mode, zwrite_dis = 0, 0
+        return (render_mode, depth_mode, zwrite_dis, quad)
+    code = generate_table("RasterizeTriangle", ranges, rasterizer_args)
+    print(code)
+
+    ranges = (
+        5,      # [render_mode], RM_OPAQUE .. RM_TRANSLUCENT_AUTOSORT
+        1 << 3, # [params->isp.DepthMode]
+        1 << 1, # [params->isp.ZWriteDis]
+    )
+    def strip_args(render_mode, depth_mode, zwrite_dis):
+        return rasterizer_args(render_mode, depth_mode, zwrite_dis, 0)[:3]
+    code = generate_table("RasterizeStrip", ranges, strip_args)
     print(code)
\ No newline at end of file
@@ -12,7 +12,7 @@
 
 #define PvrReg(x,t) (*(t*)&emu_regs[(x/4) & pvr_RegMask])
 
-extern const uint32_t* emu_regs;
+extern thread_local const uint32_t* emu_regs;
 
 #define ID_addr                 0x00000000 // R   Device ID
 #define REVISION_addr           0x00000004 // R   Revision number
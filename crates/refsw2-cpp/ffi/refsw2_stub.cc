@@ -2,16 +2,76 @@
 #include "refsw_tile.h"
 #include "TexUtils.h"
 
-uint8_t* emu_vram;
-const uint32_t* emu_regs;
+#include <mutex>
+
+// Bound to the calling thread for the duration of a render, so that contexts can render concurrently
+thread_local uint8_t* emu_vram;
+thread_local const uint32_t* emu_regs;
+
+// Context used by the single instance API
+static RefswContext* DefaultContext() {
+    static RefswContext* ctx = CreateRefswContext();
+    return ctx;
+}
 
 void ffi_refsw2_render(uint8_t* vram, const uint32_t* regs) {
+    ffi_refsw2_render_ctx(DefaultContext(), vram, regs);
+}
+
+void ffi_refsw2_init(void) {
+    static std::once_flag once;
+    std::call_once(once, InitTexUtils);
+}
+
+void ffi_refsw2_set_threads(uint32_t threads) {
+    ffi_refsw2_set_threads_ctx(DefaultContext(), threads);
+}
+
+void ffi_refsw2_set_fixed_point(bool enable) {
+    ffi_refsw2_set_fixed_point_ctx(DefaultContext(), enable);
+}
+
+RefswContext* ffi_refsw2_create_context(void) {
+    return CreateRefswContext();
+}
+
+void ffi_refsw2_destroy_context(RefswContext* ctx) {
+    DestroyRefswContext(ctx);
+}
+
+void ffi_refsw2_render_ctx(RefswContext* ctx, uint8_t* vram, const uint32_t* regs) {
+    WaitRenderCORE(ctx);
+
     emu_vram = vram;
     emu_regs = regs;
 
-    RenderCORE();
+    RenderCORE(ctx);
 }
 
-void ffi_refsw2_init(void) {
-    InitTexUtils();
-}
\ No newline at end of file
+void ffi_refsw2_set_threads_ctx(RefswContext* ctx, uint32_t threads) {
+    SetRenderThreads(ctx, threads);
+}
+
+void ffi_refsw2_set_fixed_point_ctx(RefswContext* ctx, bool enable) {
+    SetFixedPointRaster(ctx, enable);
+}
+
+void ffi_refsw2_render_async(RefswContext* ctx, uint8_t* vram, const uint32_t* regs) {
+    RenderCOREAsync(ctx, vram, regs);
+}
+
+bool ffi_refsw2_render_poll(RefswContext* ctx) {
+    return PollRenderCORE(ctx);
+}
+
+void ffi_refsw2_render_wait(RefswContext* ctx) {
+    WaitRenderCORE(ctx);
+}
+
+void ffi_refsw2_setup_cache_stats(RefswContext* ctx, uint64_t* hits, uint64_t* misses) {
+    GetSetupCacheStats(ctx, hits, misses);
+}
+
+void ffi_refsw2_verify_stats(RefswContext* ctx, uint64_t* spans, uint64_t* mismatches) {
+    GetVerifyStats(ctx, spans, mismatches);
+}
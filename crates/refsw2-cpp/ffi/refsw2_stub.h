@@ -1,12 +1,39 @@
 #pragma once
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct RefswContext RefswContext;
+
 void ffi_refsw2_render(uint8_t* vram, const uint32_t* regs);
 void ffi_refsw2_init(void);
+// 0 = one worker per hardware thread, 1 = serial (default)
+void ffi_refsw2_set_threads(uint32_t threads);
+// Rasterize with fixed point edge equations (4 sub-pixel bits, exact top-left rule) instead of float ones
+void ffi_refsw2_set_fixed_point(bool enable);
+
+// Independent renderer instances. Different contexts may render concurrently from different threads.
+RefswContext* ffi_refsw2_create_context(void);
+void ffi_refsw2_destroy_context(RefswContext* ctx);
+void ffi_refsw2_render_ctx(RefswContext* ctx, uint8_t* vram, const uint32_t* regs);
+void ffi_refsw2_set_threads_ctx(RefswContext* ctx, uint32_t threads);
+void ffi_refsw2_set_fixed_point_ctx(RefswContext* ctx, bool enable);
+
+// Start rendering a frame on a background thread. VRAM and registers are snapshotted before returning.
+// The framebuffer is written to vram by ffi_refsw2_render_poll / ffi_refsw2_render_wait once the frame is done,
+// which must be called from the thread that owns vram.
+void ffi_refsw2_render_async(RefswContext* ctx, uint8_t* vram, const uint32_t* regs);
+// Returns true if no frame is pending anymore
+bool ffi_refsw2_render_poll(RefswContext* ctx);
+void ffi_refsw2_render_wait(RefswContext* ctx);
+
+// Triangle setup cache lookups of the last frame. Misses are the triangles set up, hits the lookups that reused a setup.
+void ffi_refsw2_setup_cache_stats(RefswContext* ctx, uint64_t* hits, uint64_t* misses);
+// TSP spans of the last frame checked against the scalar pipeline, and the ones that differed. Always 0 unless built with REFSW_VERIFY_TSP.
+void ffi_refsw2_verify_stats(RefswContext* ctx, uint64_t* spans, uint64_t* mismatches);
 
 #ifdef __cplusplus
 }
@@ -73,6 +73,11 @@
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "pvr_regs.h"
 
@@ -83,18 +88,25 @@
 #include "refsw_tile.h"
 
 
-extern uint8_t* emu_vram;
+extern thread_local uint8_t* emu_vram;
 FILE* rendlog;
 
 /*
     Main renderer class
 */
-void RenderTriangle(RenderMode render_mode, DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area)
+void RenderTriangle(TileContext* tile, RenderMode render_mode, DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area)
 {   
-    RasterizeTriangle_table[render_mode](params, tag, v1, v2, v3, v4, area);
+    if (tile->coverageRecording)
+        BeginPrimitiveCoverage(tile);
 
-    if (render_mode == RM_TRANSLUCENT_PRESORT) {
-        RenderParamTags<RM_TRANSLUCENT_PRESORT>(area->left, area->top);
+    uint32_t rows = RasterizeTriangle_table[render_mode][params->isp.DepthMode][params->isp.ZWriteDis][v4 != nullptr](tile, params, tag, v1, v2, v3, v4, area);
+
+    if (tile->coverageRecording)
+        EndPrimitiveCoverage(tile, tag);
+
+    // The tags of the triangle are the only valid ones, and they lie in the rows it rasterized
+    if (render_mode == RM_TRANSLUCENT_PRESORT && rows != 0) {
+        RenderParamTags<RM_TRANSLUCENT_PRESORT>(tile, area->left, area->top, rows);
     }
 
     if (render_mode == RM_MODIFIER)
@@ -103,12 +115,12 @@ void RenderTriangle(RenderMode render_mode, DrawParameters* params, parameter_ta
         if (params->isp.modvol.VolumeMode == 1 ) 
         {
             RENDLOG("STENCIL_SUM_OR");
-            SummarizeStencilOr();
+            SummarizeStencilOr(tile);
         }
         else if (params->isp.modvol.VolumeMode == 2) 
         {
             RENDLOG("STENCIL_SUM_AND");
-            SummarizeStencilAnd();
+            SummarizeStencilAnd(tile);
         }
     }
 }
@@ -162,7 +174,7 @@ ISP_BACKGND_T_type CoreTagFromDesc(uint32_t cache_bypass, uint32_t shadow, uint3
 }
 
 // render a triangle strip object list entry
-void RenderTriangleStrip(RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
+void RenderTriangleStrip(TileContext* tile, RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
 {
     Vertex vtx[8];
     DrawParameters params;
@@ -172,7 +184,14 @@ void RenderTriangleStrip(RenderMode render_mode, ObjectListEntry obj, taRECT* re
     uint32_t tag_address = param_base + obj.tstrip.param_offs_in_words * 4;
 
     bool two_volumes = obj.tstrip.shadow & ~FPU_SHAD_SCALE.intensity_shadow;
-    decode_pvr_vertices(&params, tag_address, obj.tstrip.skip, two_volumes, vtx, 8, 0);
+    decode_pvr_positions(&params, tag_address, obj.tstrip.skip, two_volumes, vtx, 8);
+
+    // Presort and modifier volumes do work after each triangle, so only the other modes
+    // can rasterize the whole strip at once. The coverage cache records triangles one by one.
+    bool whole_strip = render_mode != RM_TRANSLUCENT_PRESORT && render_mode != RM_MODIFIER && !tile->coverageRecording;
+
+    StripTriangle triangles[6];
+    int count = 0;
 
     for (int i = 0; i < 6; i++)
     {
@@ -188,14 +207,20 @@ void RenderTriangleStrip(RenderMode render_mode, ObjectListEntry obj, taRECT* re
                 vtx[i+2].x, vtx[i+2].y, vtx[i+2].z,
                 i
             );
-            RenderTriangle(render_mode, &params, tag, vtx[i+not_even], vtx[i+even], vtx[i+2], nullptr, rect);
+            if (whole_strip)
+                triangles[count++] = { tag, &vtx[i+not_even], &vtx[i+even], &vtx[i+2] };
+            else
+                RenderTriangle(tile, render_mode, &params, tag, vtx[i+not_even], vtx[i+even], vtx[i+2], nullptr, rect);
         }
     }
+
+    if (count != 0)
+        RasterizeStrip_table[render_mode][params.isp.DepthMode][params.isp.ZWriteDis](tile, &params, triangles, count, rect);
 }
 
 
 // render a triangle array object list entry
-void RenderTriangleArray(RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
+void RenderTriangleArray(TileContext* tile, RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
 {
     auto triangles = obj.tarray.prims + 1;
     uint32_t param_base = PARAM_BASE & 0xF00000;
@@ -210,7 +235,7 @@ void RenderTriangleArray(RenderMode render_mode, ObjectListEntry obj, taRECT* re
         Vertex vtx[3];
 
         uint32_t tag_address = param_ptr;
-        param_ptr = decode_pvr_vertices(&params, tag_address, obj.tarray.skip, two_volumes, vtx, 3, 0);
+        param_ptr = decode_pvr_positions(&params, tag_address, obj.tarray.skip, two_volumes, vtx, 3);
             
         parameter_tag_t tag  = CoreTagFromDesc(params.isp.CacheBypass, obj.tstrip.shadow, obj.tstrip.skip, (tag_address - param_base)/4, 0).full;
 
@@ -221,12 +246,12 @@ void RenderTriangleArray(RenderMode render_mode, ObjectListEntry obj, taRECT* re
             i
         );
 
-        RenderTriangle(render_mode, &params, tag, vtx[0], vtx[1], vtx[2], nullptr, rect);
+        RenderTriangle(tile, render_mode, &params, tag, vtx[0], vtx[1], vtx[2], nullptr, rect);
     }
 }
 
 // render a quad array object list entry
-void RenderQuadArray(RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
+void RenderQuadArray(TileContext* tile, RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
 {
     auto quads = obj.qarray.prims + 1;
     uint32_t param_base = PARAM_BASE & 0xF00000;
@@ -241,7 +266,7 @@ void RenderQuadArray(RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
         Vertex vtx[4];
 
         uint32_t tag_address = param_ptr;
-        param_ptr = decode_pvr_vertices(&params, tag_address, obj.qarray.skip, two_volumes, vtx, 4, 0);
+        param_ptr = decode_pvr_positions(&params, tag_address, obj.qarray.skip, two_volumes, vtx, 4);
             
         parameter_tag_t tag = CoreTagFromDesc(params.isp.CacheBypass, obj.qarray.shadow, obj.qarray.skip, (tag_address - param_base)/4, 0).full;
 
@@ -253,12 +278,12 @@ void RenderQuadArray(RenderMode render_mode, ObjectListEntry obj, taRECT* rect)
             i
         );
 
-        RenderTriangle(render_mode, &params, tag, vtx[0], vtx[1], vtx[2], &vtx[3], rect);
+        RenderTriangle(tile, render_mode, &params, tag, vtx[0], vtx[1], vtx[2], &vtx[3], rect);
     }
 }
 
 // Render an object list
-void RenderObjectList(RenderMode render_mode, pvr32addr_t base, taRECT* rect)
+void RenderObjectList(TileContext* tile, RenderMode render_mode, pvr32addr_t base, taRECT* rect)
 {
     ObjectListEntry obj;
 
@@ -268,7 +293,7 @@ void RenderObjectList(RenderMode render_mode, pvr32addr_t base, taRECT* rect)
         base += 4;
 
         if (!obj.is_not_triangle_strip) {
-            RenderTriangleStrip(render_mode, obj, rect);
+            RenderTriangleStrip(tile, render_mode, obj, rect);
         } else {
             switch(obj.type) {
                 case 0b111: // link
@@ -279,11 +304,11 @@ void RenderObjectList(RenderMode render_mode, pvr32addr_t base, taRECT* rect)
                     break;
 
                 case 0b100: // triangle array
-                    RenderTriangleArray(render_mode, obj, rect);
+                    RenderTriangleArray(tile, render_mode, obj, rect);
                     break;
                     
                 case 0b101: // quad array
-                    RenderQuadArray(render_mode, obj, rect);
+                    RenderQuadArray(tile, render_mode, obj, rect);
                     break;
 
                 default:
@@ -293,244 +318,1088 @@ void RenderObjectList(RenderMode render_mode, pvr32addr_t base, taRECT* rect)
     }
 }
 
-// Render a frame
-// Called on START_RENDER write
-void RenderCORE() {
+// Render a region array entry (one tile pass) using the buffers in tile
+void RenderRegionEntry(TileContext* tile, const RegionArrayEntry& entry)
+{
+    taRECT rect;
+    rect.top = entry.control.tiley * 32;
+    rect.left = entry.control.tilex * 32;
+
+    rect.bottom = rect.top + 32;
+    rect.right = rect.left + 32;
+
+    parameter_tag_t bgTag;
+
+    ClearFpuCache(tile);
+    // register BGPOLY to fpu
     {
-        auto field = SCALER_CTL.fieldselect;
-        auto interlace = SCALER_CTL.interlace;
+        bgTag = ISP_BACKGND_T.full;
+    }
 
-        auto base = (interlace && field) ? FB_W_SOF2 : FB_W_SOF1;
-        // printf("Rendering to %x\n", (interlace && field) ? FB_W_SOF2 : FB_W_SOF1);
+    // Tile needs clear?
+    if (!entry.control.z_keep)
+    {
+        RENDLOG("ZCLEAR");
+        // Clear Param + Z + stencil buffers
+        ClearBuffers(tile, bgTag, ISP_BACKGND_D.f, 0);
+    } else {
+        RENDLOG("ZKEEP");
+        ClearParamStatusBuffer(tile);
     }
-    uint32_t base = REGION_BASE;
 
-    RegionArrayEntry entry;
+    // Render OPAQ to TAGS
+    if (!entry.opaque.empty)
+    {
+        RENDLOG("OPAQ");
+        RenderObjectList(tile, RM_OPAQUE, entry.opaque.ptr_in_words * 4, &rect);
     
-    RENDLOG("REFSW2LOG: 0");
-    RENDLOG("BGTAG: %08X", ISP_BACKGND_T.full);
+        // Only shadowed tags read the stencil. The punch through and autosort passes clear it,
+        // otherwise it is kept for the presort pass and the next region array entry.
+        bool stencilCleared = !entry.puncht.empty || (!entry.trans.empty && !entry.control.pre_sort);
 
-    // Parse region array
-    do {
-        auto step = ReadRegionArrayEntry(base, &entry);
+        if (!entry.opaque_mod.empty && (!stencilCleared || HasShadowedTags(tile, false)))
+        {
+            RENDLOG("OPAQ_MOD");
+            RenderObjectList(tile, RM_MODIFIER, entry.opaque_mod.ptr_in_words * 4, &rect);
+        }
+    }
+
+    RENDLOG("OP_PARAMS");
+    // Render TAGS to ACCUM
+    RenderParamTags<RM_OPAQUE>(tile, rect.left, rect.top);
+
+    // render PT to TAGS
+    if (!entry.puncht.empty)
+    {
+        RENDLOG("PT");
+
+        PeelBuffersPTInitial(tile, FLT_MAX);
         
-        RENDLOG("TILE: %08X %08X %08X %08X %08X %08X %08X", base, entry.control.full, entry.opaque.full, entry.opaque_mod.full, entry.trans.full, entry.trans_mod.full, entry.puncht.full);
+        ClearMoreToDraw(tile);
 
-        base += step;
+        // Render to TAGS, caching the coverage for the next passes
+        BeginCoverageCache(tile);
+        RenderObjectList(tile, RM_PUNCHTHROUGH_PASS0, entry.puncht.ptr_in_words * 4, &rect);
+        EndCoverageCache(tile);
 
-        taRECT rect;
-        rect.top = entry.control.tiley * 32;
-        rect.left = entry.control.tilex * 32;
+        // keep reference Z buffer
+        PeelBuffersPT(tile);
 
-        rect.bottom = rect.top + 32;
-        rect.right = rect.left + 32;
+        RENDLOG("PT_PARAMS");
+        // Render TAGS to ACCUM, making Z holes as-needed
+        RenderParamTags<RM_PUNCHTHROUGH_PASS0>(tile, rect.left, rect.top);
 
-        parameter_tag_t bgTag;
+        while (GetMoreToDraw(tile)) {
+            RENDLOG("PT_N");
+            ClearMoreToDraw(tile);
 
-        ClearFpuCache();
-        // register BGPOLY to fpu
+            // Render to TAGS
+            if (tile->coverageValid)
+                RenderCoverageCache<RM_PUNCHTHROUGH_PASSN>(tile);
+            else
+                RenderObjectList(tile, RM_PUNCHTHROUGH_PASSN, entry.puncht.ptr_in_words * 4, &rect);
+
+            if (!GetMoreToDraw(tile))
+                break;
+            
+            ClearMoreToDraw(tile);
+            // keep reference Z buffer
+            PeelBuffersPT(tile);
+
+            RENDLOG("PT_N_PARAMS");
+            // Render TAGS to ACCUM, making Z holes as-needed
+            RenderParamTags<RM_PUNCHTHROUGH_PASS0>(tile, rect.left, rect.top);
+        }
+        if (!entry.opaque_mod.empty)
         {
-            bgTag = ISP_BACKGND_T.full;
+            // As for OPAQ_MOD, the stencil is kept unless the autosort pass clears it
+            bool stencilCleared = !entry.trans.empty && !entry.control.pre_sort;
+            bool shadowed = HasShadowedTags(tile, true);
+
+            if (shadowed || !stencilCleared) {
+                RENDLOG("PT_MOD");
+                RenderObjectList(tile, RM_MODIFIER, entry.opaque_mod.ptr_in_words * 4, &rect);
+            }
+
+            if (shadowed) {
+                RENDLOG("PT_MOD_PARAMS");
+                RenderParamTags<RM_PUNCHTHROUGH_MV>(tile, rect.left, rect.top);
+            }
         }
+    }
 
-        // Tile needs clear?
-        if (!entry.control.z_keep)
-        {
-            RENDLOG("ZCLEAR");
-            // Clear Param + Z + stencil buffers
-            ClearBuffers(bgTag, ISP_BACKGND_D.f, 0);
+    // layer peeling rendering
+    if (!entry.trans.empty)
+    {
+        if (entry.control.pre_sort) {
+            RENDLOG("TR_PS");
+             // clear the param buffer
+             ClearParamStatusBuffer(tile);
+
+             // render to TAGS
+             {
+                 RenderObjectList(tile, RM_TRANSLUCENT_PRESORT, entry.trans.ptr_in_words * 4, &rect);
+             }
+
+            // what happens with modvols here?
+            //  if (!entry.trans_mod.empty)
+            //  {
+            //      RenderObjectList(tile, RM_MODIFIER, entry.trans_mod.ptr_in_words * 4, &rect);
+            //  }
         } else {
-            RENDLOG("ZKEEP");
-            ClearParamStatusBuffer();
+            RENDLOG("TR_AS");
+            SetTagToMax(tile);
+            bool firstPass = true;
+            do
+            {
+                RENDLOG("TR_AS_N");
+                // prepare for a new pass
+                ClearMoreToDraw(tile);
+
+                // copy depth test to depth reference buffer, clear depth test buffer, clear stencil
+                PeelBuffers(tile, FLT_MAX, 0);
+
+                // render to TAGS, caching the coverage for the next passes
+                if (firstPass) {
+                    BeginCoverageCache(tile);
+                    RenderObjectList(tile, RM_TRANSLUCENT_AUTOSORT, entry.trans.ptr_in_words * 4, &rect);
+                    EndCoverageCache(tile);
+                    firstPass = false;
+                } else if (tile->coverageValid) {
+                    RenderCoverageCache<RM_TRANSLUCENT_AUTOSORT>(tile);
+                } else {
+                    RenderObjectList(tile, RM_TRANSLUCENT_AUTOSORT, entry.trans.ptr_in_words * 4, &rect);
+                }
+
+                // When there is another pass it clears the stencil, so only the shadowed tags of this one read it
+                if (!entry.trans_mod.empty && (!GetMoreToDraw(tile) || HasShadowedTags(tile, false)))
+                {
+                    RenderObjectList(tile, RM_MODIFIER, entry.trans_mod.ptr_in_words * 4, &rect);
+                }
+
+                RENDLOG("TR_PARAMS");
+                // render TAGS to ACCUM
+                RenderParamTags<RM_TRANSLUCENT_AUTOSORT>(tile, rect.left, rect.top);
+            } while (GetMoreToDraw(tile) != 0);
         }
+    }
 
-        // Render OPAQ to TAGS
-        if (!entry.opaque.empty)
+    {
+        auto copy = (uint32_t*)GetColorOutputBuffer(tile);
+        RENDLOG("PIXELS");
+        for (unsigned i = 0; i < MAX_RENDER_PIXELS; i++)
         {
-            RENDLOG("OPAQ");
-            RenderObjectList(RM_OPAQUE, entry.opaque.ptr_in_words * 4, &rect);
-        
-            if (!entry.opaque_mod.empty)
+            RENDLOG("%08X", copy[i]);
+        }
+    }
+    
+    // Copy to vram
+    if (!entry.control.no_writeout)
+    {
+        // Precomputed “threshold biases” = bias4[bayer4[i][j]]
+        static constexpr uint8_t bayerBias[4][4] = {
+            {   8, 136,  40, 168 },  // 0→8, 8→136, 2→40, 10→168
+            { 200,  72, 232, 104 },  //12→200,4→72, 14→232,6→104
+            {  56, 184,  24, 152 },  // 3→56,11→184,1→24, 9→152
+            { 248, 120, 216,  88 }   //15→248,7→120,13→216,5→88
+        };
+
+        auto copy = GetColorOutputBuffer(tile);
+
+        auto field = SCALER_CTL.fieldselect;
+        auto interlace = SCALER_CTL.interlace;
+
+        auto base = (interlace && field) ? FB_W_SOF2 : FB_W_SOF1;
+
+        // very few configurations supported here
+        assert(SCALER_CTL.hscale == 0);
+        assert(SCALER_CTL.interlace == 0); // write both SOFs
+        auto vscale = SCALER_CTL.vscalefactor;
+        assert(vscale == 0x401 || vscale == 0x400 || vscale == 0x800);
+
+        auto fb_packmode = FB_W_CTRL.fb_packmode;
+        assert(fb_packmode == 0x1 || fb_packmode == 0x6); // 565 RGB16
+
+        auto src = copy;
+        auto bpp = fb_packmode == 0x1 ? 2 : 4;
+        auto offset_bytes = entry.control.tilex * 32 * bpp + entry.control.tiley * 32 * FB_W_LINESTRIDE.stride * 8;
+
+        for (int y = 0; y < 32; y++)
+        {
+            //auto base = (y&1) ? FB_W_SOF2 : FB_W_SOF1;
+            auto dst = base + offset_bytes + (y)*FB_W_LINESTRIDE.stride * 8;
+            tile->writeoutRows.push_back(dst);
+
+            for (int x = 0; x < 32; x++)
             {
-                RENDLOG("OPAQ_MOD");
-                RenderObjectList(RM_MODIFIER, entry.opaque_mod.ptr_in_words * 4, &rect);
+                if (fb_packmode == 0x1) {
+                    int r8 = src[0];
+                    int g8 = src[1];
+                    int b8 = src[2];
+
+                    int T = bayerBias[y & 3][x & 3];
+
+                    // integer quantize exactly as before
+                    int r5 = (r8 * 31 + T) / 255;
+                    int g6 = (g8 * 63 + T) / 255;
+                    int b5 = (b8 * 31 + T) / 255;
+
+                    // clamp (just in case)
+                    if(r5<0) r5=0; else if(r5>31) r5=31;
+                    if(g6<0) g6=0; else if(g6>63) g6=63;
+                    if(b5<0) b5=0; else if(b5>31) b5=31;
+                    
+                    auto pixel = (r5 << 0) | (g6 << 5) | (b5 << 11);
+                    pvr_write_area1_16(emu_vram, dst, pixel);
+                }
+                else {
+                    auto pixel = src[0] + src[1] * 256U + src[2] * 256U * 256U + src[3]  * 256U * 256U * 256U;
+                    pvr_write_area1_32(emu_vram, dst, pixel);
+                }
+                
+
+                dst += bpp;
+                src += 4; // skip alpha
             }
         }
+    }
+}
 
-        RENDLOG("OP_PARAMS");
-        // Render TAGS to ACCUM
-        RenderParamTags<RM_OPAQUE>(rect.left, rect.top);
+/*
+    Region array order
+
+    The serial walk renders every entry with the same TileContext, so an entry can see what the
+    previous entry in region array order left behind, even at another tile position:
+    - the tile buffers, through z_keep, or through opaque blending that reads the color buffer
+      before the entry wrote it
+    - the secondary accumulation buffer
+    - the offset color, read by bump maps and by the per vertex fog of untextured polygons
+    - the framebuffer, through texture reads, or rows shared by two tile positions
+    Tile workers can't reproduce that, so frames where it may happen are rendered serially.
+    The test is conservative, and only reads the region array, the object lists and the
+    parameter words of the tags they reference.
+*/
 
-        // render PT to TAGS
-        if (!entry.puncht.empty)
-        {
-            RENDLOG("PT");
+// Whether a volume of a tag reads state that the serial walk carries from one entry to the next
+static bool ReadsCarriedState(ISP_TSP isp, TSP tsp, TCW tcw)
+{
+    if (tsp.SrcSelect || tsp.DstSelect)
+        return true;
 
-            PeelBuffersPTInitial(FLT_MAX);
-            
-            ClearMoreToDraw();
+    // the offset color is only written by textured pixels with one
+    if (isp.Texture && tcw.PixelFmt == PixelBumpMap && !isp.Offset)
+        return true;
 
-            // Render to TAGS
-            RenderObjectList(RM_PUNCHTHROUGH_PASS0, entry.puncht.ptr_in_words * 4, &rect);
+    if (!isp.Texture && isp.Offset && tsp.FogCtrl == 0b01)
+        return true;
 
-            // keep reference Z buffer
-            PeelBuffersPT();
+    return false;
+}
 
-            RENDLOG("PT_PARAMS");
-            // Render TAGS to ACCUM, making Z holes as-needed
-            RenderParamTags<RM_PUNCHTHROUGH_PASS0>(rect.left, rect.top);
+// Whether blending reads the color buffer, see BlendingUnit
+static bool ReadsColorBuffer(TSP tsp)
+{
+    return tsp.DstInstr != 0 || (tsp.SrcInstr >> 1) == 1 || (tsp.SrcInstr >> 1) == 3;
+}
 
-            while (GetMoreToDraw()) {
-                RENDLOG("PT_N");
-                ClearMoreToDraw();
+// VRAM a texture may read, as a conservative [begin, end) range of the 64 bit view. Can go past VRAM_SIZE
+static void TextureRange(TSP tsp, TCW tcw, uint64_t* begin, uint64_t* end)
+{
+    uint64_t width = 8 << tsp.TexU, height = 8 << tsp.TexV;
+    uint64_t stride = std::max<uint64_t>(width, (TEXT_CONTROL & 31) * 32);
 
-                // Render to TAGS
-                RenderObjectList(RM_PUNCHTHROUGH_PASSN, entry.puncht.ptr_in_words * 4, &rect);
+    // mip maps take less than the base level, and VQ indices less than the texels
+    uint64_t texels = width + 2 * stride * std::max(width, height);
 
-                if (!GetMoreToDraw())
+    *begin = (tcw.TexAddr << 3) & VRAM_MASK;
+    *end = *begin + 256 * 4 * 2 + texels * 2 + 8;
+}
+
+struct FrameOrderCheck
+{
+    uint64_t fbBegin = UINT64_MAX, fbEnd = 0;   // framebuffer writes, in the 64 bit view
+
+    // Whether the tag at param_offs_in_words reads state from other entries. Opaque tags of an entry
+    // that doesn't follow its own position also can't read the color buffer
+    bool TagNeedsOrder(uint32_t param_offs_in_words, uint32_t shadow, bool opaque)
+    {
+        uint32_t base = PARAM_BASE + param_offs_in_words * 4;
+        bool two_volumes = shadow & ~FPU_SHAD_SCALE.intensity_shadow;
+
+        ISP_TSP isp;
+        isp.full = vri(emu_vram, base);
+
+        for (uint32_t volume = 0; volume <= two_volumes; volume++) {
+            TSP tsp;
+            TCW tcw;
+            tsp.full = vri(emu_vram, base + 4 + volume * 8);
+            tcw.full = vri(emu_vram, base + 8 + volume * 8);
+
+            if (ReadsCarriedState(isp, tsp, tcw) || (opaque && ReadsColorBuffer(tsp)))
+                return true;
+
+            if (isp.Texture) {
+                uint64_t begin, end;
+                TextureRange(tsp, tcw, &begin, &end);
+
+                bool overlaps = begin < fbEnd && fbBegin < end;
+                bool wraps = end > VRAM_SIZE && fbBegin < end - VRAM_SIZE;
+                if (overlaps || wraps)
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Walk an object list the way RenderObjectList does, checking the tag of every primitive
+    bool ListNeedsOrder(pvr32addr_t base, bool opaque)
+    {
+        uint32_t param_base = PARAM_BASE & 0xF00000;
+        ObjectListEntry obj;
+
+        for (;;) {
+            obj.full = vri(emu_vram, base);
+            base += 4;
+
+            if (!obj.is_not_triangle_strip) {
+                if (TagNeedsOrder(obj.tstrip.param_offs_in_words, obj.tstrip.shadow, opaque))
+                    return true;
+                continue;
+            }
+
+            switch(obj.type) {
+                case 0b111: // link
+                    if (obj.link.end_of_list)
+                        return false;
+
+                    base = obj.link.next_block_ptr_in_words * 4;
                     break;
-                
-                ClearMoreToDraw();
-                // keep reference Z buffer
-                PeelBuffersPT();
 
-                RENDLOG("PT_N_PARAMS");
-                // Render TAGS to ACCUM, making Z holes as-needed
-                RenderParamTags<RM_PUNCHTHROUGH_PASS0>(rect.left, rect.top);
+                case 0b100: // triangle array
+                case 0b101: // quad array
+                {
+                    uint32_t vertices = obj.type == 0b100 ? 3 : 4;
+                    bool two_volumes = obj.tarray.shadow & ~FPU_SHAD_SCALE.intensity_shadow;
+                    uint32_t param_ptr = param_base + obj.tarray.param_offs_in_words * 4;
+
+                    for (uint32_t i = 0; i <= obj.tarray.prims; i++) {
+                        if (TagNeedsOrder((param_ptr - param_base) / 4, obj.tarray.shadow, opaque))
+                            return true;
+                        param_ptr += (two_volumes ? 20 : 12) + vertices * (3 + obj.tarray.skip * (two_volumes + 1)) * 4;
+                    }
+                    break;
+                }
             }
-            if (!entry.opaque_mod.empty)
-            {
-                RENDLOG("PT_MOD");
-                RenderObjectList(RM_MODIFIER, entry.opaque_mod.ptr_in_words * 4, &rect);
-                RENDLOG("PT_MOD_PARAMS");
-                RenderParamTags<RM_PUNCHTHROUGH_MV>(rect.left, rect.top);
+        }
+    }
+
+    // Add the writeout of an entry to the framebuffer range. Returns false if it can share
+    // rows with another tile position
+    bool AddWriteout(const RegionArrayEntry& entry, uint32_t maxTileX)
+    {
+        if (entry.control.no_writeout)
+            return true;
+
+        uint32_t bpp = FB_W_CTRL.fb_packmode == 0x1 ? 2 : 4;
+        uint32_t stride = FB_W_LINESTRIDE.stride * 8;
+        if (stride < (maxTileX + 1) * 32 * bpp)
+            return false;
+
+        auto base = (SCALER_CTL.interlace && SCALER_CTL.fieldselect) ? FB_W_SOF2 : FB_W_SOF1;
+        auto offset_bytes = entry.control.tilex * 32 * bpp + entry.control.tiley * 32 * stride;
+
+        for (uint32_t y = 0; y < 32; y++) {
+            uint32_t row = base + offset_bytes + y * stride;
+
+            // pvr_map32 keeps the order of the addresses inside a bank
+            for (uint32_t begin = row, end = row + 32 * bpp; begin < end; ) {
+                uint32_t bankEnd = std::min(end, (begin | (VRAM_BANK_BIT - 1)) + 1);
+                fbBegin = std::min<uint64_t>(fbBegin, pvr_map32(begin & ~3));
+                fbEnd = std::max<uint64_t>(fbEnd, pvr_map32((bankEnd - 1) & ~3) + 4);
+                begin = bankEnd;
             }
         }
 
-        // layer peeling rendering
-        if (!entry.trans.empty)
-        {
-            if (entry.control.pre_sort) {
-                RENDLOG("TR_PS");
-                 // clear the param buffer
-                 ClearParamStatusBuffer();
-
-                 // render to TAGS
-                 {
-                     RenderObjectList(RM_TRANSLUCENT_PRESORT, entry.trans.ptr_in_words * 4, &rect);
-                 }
-
-                // what happens with modvols here?
-                //  if (!entry.trans_mod.empty)
-                //  {
-                //      RenderObjectList(RM_MODIFIER, entry.trans_mod.ptr_in_words * 4, &rect);
-                //  }
-            } else {
-                RENDLOG("TR_AS");
-                SetTagToMax();
-                do
-                {
-                    RENDLOG("TR_AS_N");
-                    // prepare for a new pass
-                    ClearMoreToDraw();
+        return true;
+    }
+};
 
-                    // copy depth test to depth reference buffer, clear depth test buffer, clear stencil
-                    PeelBuffers(FLT_MAX, 0);
+// Whether the entries of a frame have to be rendered in region array order, on a single TileContext
+static bool NeedsRegionOrder(const std::vector<RegionArrayEntry>& entries)
+{
+    FrameOrderCheck check;
 
-                    // render to TAGS
-                    {
-                        RenderObjectList(RM_TRANSLUCENT_AUTOSORT, entry.trans.ptr_in_words * 4, &rect);
-                    }
+    uint32_t maxTileX = 0;
+    for (auto& entry: entries) {
+        maxTileX = std::max<uint32_t>(maxTileX, entry.control.tilex);
+    }
+
+    for (auto& entry: entries) {
+        if (!check.AddWriteout(entry, maxTileX))
+            return true;
+    }
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        auto& entry = entries[i];
+
+        // Entries that don't follow an entry at their own position start from buffers another position left
+        bool followsOwnTile = i > 0 && entries[i - 1].control.tilex == entry.control.tilex && entries[i - 1].control.tiley == entry.control.tiley;
+
+        if (!followsOwnTile && entry.control.z_keep)
+            return true;
+
+        if (check.TagNeedsOrder(ISP_BACKGND_T.param_offs_in_words, ISP_BACKGND_T.shadow, !followsOwnTile))
+            return true;
+
+        if (!entry.opaque.empty && check.ListNeedsOrder(entry.opaque.ptr_in_words * 4, !followsOwnTile))
+            return true;
 
-                    if (!entry.trans_mod.empty)
-                    {
-                        RenderObjectList(RM_MODIFIER, entry.trans_mod.ptr_in_words * 4, &rect);
+        if (!entry.puncht.empty && check.ListNeedsOrder(entry.puncht.ptr_in_words * 4, false))
+            return true;
+
+        if (!entry.trans.empty && check.ListNeedsOrder(entry.trans.ptr_in_words * 4, false))
+            return true;
+    }
+
+    return false;
+}
+
+// Copy the tile buffers the next entry of the serial walk can read, see RenderCORE
+static void CopyTileBuffers(TileContext* dst, const TileContext* src)
+{
+    dst->tagStatus = src->tagStatus;
+    memcpy(dst->tagBuffer, src->tagBuffer, sizeof(dst->tagBuffer));
+    dst->stencil = src->stencil;
+    memcpy(dst->colorBuffer1, src->colorBuffer1, sizeof(dst->colorBuffer1));
+    memcpy(dst->depthBuffer, src->depthBuffer, sizeof(dst->depthBuffer));
+    memcpy(dst->hizMin, src->hizMin, sizeof(dst->hizMin));
+    dst->hizValid = src->hizValid;
+}
+
+/*
+    Frame footprint
+
+    The VRAM a frame can read: the region array, the object lists, the parameters of the tags
+    they reference, and the textures of those tags. The lists are walked the same way as in
+    FrameOrderCheck, and the ranges are conservative, so that an asynchronous render only has
+    to snapshot them instead of the whole VRAM.
+*/
+struct VramRange
+{
+    uint32_t begin, end; // in the 64 bit view
+};
+
+struct FrameFootprint
+{
+    std::vector<VramRange>& ranges;
+
+    // Add a range of the 32 bit area
+    void Add32(uint32_t begin, uint32_t end)
+    {
+        // pvr_map32 keeps the order of the addresses inside a bank
+        while (begin < end) {
+            uint32_t bankEnd = std::min(end, (begin | (VRAM_BANK_BIT - 1)) + 1);
+            ranges.push_back({ pvr_map32(begin & ~3), pvr_map32((bankEnd - 1) & ~3) + 4 });
+            begin = bankEnd;
+        }
+    }
+
+    // Add a range of the 64 bit view, wrapping at VRAM_SIZE as texture reads do
+    void Add64(uint64_t begin, uint64_t end)
+    {
+        ranges.push_back({ (uint32_t)begin, (uint32_t)std::min<uint64_t>(end, VRAM_SIZE) });
+        if (end > VRAM_SIZE) {
+            ranges.push_back({ 0, (uint32_t)std::min<uint64_t>(end - VRAM_SIZE, VRAM_SIZE) });
+        }
+    }
+
+    // Add the parameters of a tag with `vertices` vertices, and its textures
+    void AddTag(uint32_t param_offs_in_words, uint32_t shadow, uint32_t skip, uint32_t vertices)
+    {
+        bool two_volumes = shadow & ~FPU_SHAD_SCALE.intensity_shadow;
+
+        // the rasterizer and the TSP don't agree on the parameter base, see GetFrameSetup
+        for (uint32_t param_base: { PARAM_BASE & 0xF00000, PARAM_BASE }) {
+            uint32_t base = param_base + param_offs_in_words * 4;
+
+            ISP_TSP isp;
+            isp.full = vri(emu_vram, base);
+
+            // decode_pvr_vertex reads the attributes isp asks for, whatever skip says
+            uint32_t attributes = (isp.Texture ? (isp.UV_16b ? 1 : 2) : 0) + 1 + isp.Offset;
+            uint32_t stride = 3 + skip * (two_volumes + 1);
+            uint32_t read = 3 + std::max(skip, attributes) * (two_volumes + 1);
+            Add32(base, base + ((two_volumes ? 5 : 3) + (vertices - 1) * stride + read) * 4);
+
+            if (isp.Texture) {
+                for (uint32_t volume = 0; volume <= two_volumes; volume++) {
+                    TSP tsp;
+                    TCW tcw;
+                    tsp.full = vri(emu_vram, base + 4 + volume * 8);
+                    tcw.full = vri(emu_vram, base + 8 + volume * 8);
+
+                    uint64_t begin, end;
+                    TextureRange(tsp, tcw, &begin, &end);
+                    Add64(begin, end);
+                }
+            }
+
+            if (param_base == PARAM_BASE)
+                break;
+        }
+    }
+
+    // Add an object list, and everything its primitives reference
+    void AddList(pvr32addr_t base)
+    {
+        uint32_t param_base = PARAM_BASE & 0xF00000;
+        uint32_t block = base;
+        ObjectListEntry obj;
+
+        for (;;) {
+            obj.full = vri(emu_vram, base);
+            base += 4;
+
+            if (!obj.is_not_triangle_strip) {
+                AddTag(obj.tstrip.param_offs_in_words, obj.tstrip.shadow, obj.tstrip.skip, 8);
+                continue;
+            }
+
+            switch(obj.type) {
+                case 0b111: // link
+                    Add32(block, base);
+                    if (obj.link.end_of_list)
+                        return;
+
+                    base = block = obj.link.next_block_ptr_in_words * 4;
+                    break;
+
+                case 0b100: // triangle array
+                case 0b101: // quad array
+                {
+                    uint32_t vertices = obj.type == 0b100 ? 3 : 4;
+                    bool two_volumes = obj.tarray.shadow & ~FPU_SHAD_SCALE.intensity_shadow;
+                    uint32_t param_ptr = param_base + obj.tarray.param_offs_in_words * 4;
+
+                    for (uint32_t i = 0; i <= obj.tarray.prims; i++) {
+                        AddTag((param_ptr - param_base) / 4, obj.tarray.shadow, obj.tarray.skip, vertices);
+                        param_ptr += (two_volumes ? 20 : 12) + vertices * (3 + obj.tarray.skip * (two_volumes + 1)) * 4;
                     }
+                    break;
+                }
+            }
+        }
+    }
+
+    // Add everything a frame reads, then sort and merge the ranges
+    void AddFrame()
+    {
+        uint32_t base = REGION_BASE;
+        RegionArrayEntry entry;
 
-                    RENDLOG("TR_PARAMS");
-                    // render TAGS to ACCUM
-                    RenderParamTags<RM_TRANSLUCENT_AUTOSORT>(rect.left, rect.top);
-                } while (GetMoreToDraw() != 0);
+        ISP_BACKGND_T_type bgTag = ISP_BACKGND_T;
+        AddTag(bgTag.param_offs_in_words, bgTag.shadow, bgTag.skip, bgTag.tag_offset + 3);
+
+        do {
+            uint32_t begin = base;
+            base += ReadRegionArrayEntry(base, &entry);
+            Add32(begin, base);
+
+            for (auto list: { entry.opaque, entry.opaque_mod, entry.trans, entry.trans_mod, entry.puncht }) {
+                if (!list.empty)
+                    AddList(list.ptr_in_words * 4);
             }
+        } while (!entry.control.last_region);
+
+        std::sort(ranges.begin(), ranges.end(), [](const VramRange& a, const VramRange& b) { return a.begin < b.begin; });
+
+        size_t merged = 0;
+        for (auto& range: ranges) {
+            if (merged != 0 && range.begin <= ranges[merged - 1].end)
+                ranges[merged - 1].end = std::max(ranges[merged - 1].end, range.end);
+            else
+                ranges[merged++] = range;
         }
+        ranges.resize(merged);
+    }
+};
 
-        {
-            auto copy = (uint32_t*)GetColorOutputBuffer();
-            RENDLOG("PIXELS");
-            for (unsigned i = 0; i < MAX_RENDER_PIXELS; i++)
+/*
+    Tile workers
+
+    Region array entries at different tile positions don't share any state besides VRAM
+    reads and their own framebuffer area, unless NeedsRegionOrder says otherwise, so they
+    can be rendered concurrently. Entries are grouped by position, and each group is rendered
+    by a single worker in region array order, as z_keep / no_writeout passes rely on the tile
+    buffers of the previous entry at the same position.
+
+    The serial TileContext is left as the serial walk would leave it, for the frames that
+    follow: it gets the tile buffers of the last entry, and the offset color last written.
+*/
+struct TileWorkers
+{
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<TileContext>> tiles;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    uint32_t running = 0;
+    bool quit = false;
+
+    // per frame job, valid while running
+    uint8_t* vram = nullptr;
+    const uint32_t* regs = nullptr;
+    const std::vector<RegionArrayEntry>* entries = nullptr;
+    const std::vector<uint32_t>* groups = nullptr; // group start offsets into entries, plus end
+    const std::vector<uint32_t>* order = nullptr;  // region array index of each entry
+    std::atomic<uint32_t> nextGroup;
+    TileContext* serialTile = nullptr;
+
+    // last offset color written by each worker, and the region array index + 1 of its entry
+    struct OffsWrite {
+        uint32_t entry;
+        Color offs;
+    };
+    std::vector<OffsWrite> offsWrites;
+
+    void RenderGroups(uint32_t id)
+    {
+        auto tile = tiles[id].get();
+        auto& offsWrite = offsWrites[id];
+        uint32_t last = entries->size() - 1;
+
+        uint32_t groupCount = groups->size() - 1;
+        for (;;) {
+            uint32_t group = nextGroup.fetch_add(1, std::memory_order_relaxed);
+            if (group >= groupCount)
+                break;
+
+            for (uint32_t i = (*groups)[group]; i < (*groups)[group + 1]; i++) {
+                uint32_t index = (*order)[i];
+
+                tile->offsWritten = false;
+                RenderRegionEntry(tile, (*entries)[i]);
+
+                if (tile->offsWritten && index + 1 > offsWrite.entry) {
+                    offsWrite = { index + 1, tile->offs };
+                }
+
+                if (index == last) {
+                    CopyTileBuffers(serialTile, tile);
+                }
+            }
+        }
+    }
+
+    void WorkerMain(uint32_t id, uint64_t seen)
+    {
+        for (;;) {
             {
-                RENDLOG("%08X", copy[i]);
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&] { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+            }
+
+            emu_vram = vram;
+            emu_regs = regs;
+
+            RenderGroups(id);
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (--running == 0)
+                    done.notify_one();
             }
         }
-        
-        // Copy to vram
-        if (!entry.control.no_writeout)
+    }
+
+    // Resize the pool. The calling thread always participates, so count - 1 threads are created.
+    void Resize(uint32_t count)
+    {
+        Stop();
+
+        quit = false;
+        while (tiles.size() < count) {
+            tiles.push_back(std::make_unique<TileContext>());
+        }
+
+        for (uint32_t i = 1; i < count; i++) {
+            threads.emplace_back(&TileWorkers::WorkerMain, this, i, generation);
+        }
+    }
+
+    void Stop()
+    {
         {
-            // Precomputed “threshold biases” = bias4[bayer4[i][j]]
-            static constexpr uint8_t bayerBias[4][4] = {
-                {   8, 136,  40, 168 },  // 0→8, 8→136, 2→40, 10→168
-                { 200,  72, 232, 104 },  //12→200,4→72, 14→232,6→104
-                {  56, 184,  24, 152 },  // 3→56,11→184,1→24, 9→152
-                { 248, 120, 216,  88 }   //15→248,7→120,13→216,5→88
-            };
+            std::lock_guard<std::mutex> guard(lock);
+            quit = true;
+        }
+        wake.notify_all();
 
-            auto copy = GetColorOutputBuffer();
+        for (auto& thread: threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
 
-            auto field = SCALER_CTL.fieldselect;
-            auto interlace = SCALER_CTL.interlace;
+    void Render(TileContext* frameSerialTile, const std::vector<RegionArrayEntry>& frameEntries, const std::vector<uint32_t>& frameGroups, const std::vector<uint32_t>& frameOrder)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            vram = emu_vram;
+            regs = emu_regs;
+            entries = &frameEntries;
+            groups = &frameGroups;
+            order = &frameOrder;
+            serialTile = frameSerialTile;
+            offsWrites.assign(tiles.size(), { 0, {} });
+            nextGroup = 0;
+            running = threads.size();
+            generation++;
+        }
+        wake.notify_all();
 
-            auto base = (interlace && field) ? FB_W_SOF2 : FB_W_SOF1;
+        RenderGroups(0);
 
-            // very few configurations supported here
-            assert(SCALER_CTL.hscale == 0);
-            assert(SCALER_CTL.interlace == 0); // write both SOFs
-            auto vscale = SCALER_CTL.vscalefactor;
-            assert(vscale == 0x401 || vscale == 0x400 || vscale == 0x800);
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            done.wait(guard, [&] { return running == 0; });
+        }
 
-            auto fb_packmode = FB_W_CTRL.fb_packmode;
-            assert(fb_packmode == 0x1 || fb_packmode == 0x6); // 565 RGB16
+        OffsWrite latest = { 0, serialTile->offs };
+        for (auto& write: offsWrites) {
+            if (write.entry > latest.entry)
+                latest = write;
+        }
+        serialTile->offs = latest.offs;
+    }
 
-            auto src = copy;
-            auto bpp = fb_packmode == 0x1 ? 2 : 4;
-            auto offset_bytes = entry.control.tilex * 32 * bpp + entry.control.tiley * 32 * FB_W_LINESTRIDE.stride * 8;
+    ~TileWorkers()
+    {
+        Stop();
+    }
+};
 
-            for (int y = 0; y < 32; y++)
-            {
-                //auto base = (y&1) ? FB_W_SOF2 : FB_W_SOF1;
-                auto dst = base + offset_bytes + (y)*FB_W_LINESTRIDE.stride * 8;
+/*
+    Renderer instance
 
-                for (int x = 0; x < 32; x++)
-                {
-                    if (fb_packmode == 0x1) {
-                        int r8 = src[0];
-                        int g8 = src[1];
-                        int b8 = src[2];
-
-                        int T = bayerBias[y & 3][x & 3];
-
-                        // integer quantize exactly as before
-                        int r5 = (r8 * 31 + T) / 255;
-                        int g6 = (g8 * 63 + T) / 255;
-                        int b5 = (b8 * 31 + T) / 255;
-
-                        // clamp (just in case)
-                        if(r5<0) r5=0; else if(r5>31) r5=31;
-                        if(g6<0) g6=0; else if(g6>63) g6=63;
-                        if(b5<0) b5=0; else if(b5>31) b5=31;
-                        
-                        auto pixel = (r5 << 0) | (g6 << 5) | (b5 << 11);
-                        pvr_write_area1_16(emu_vram, dst, pixel);
-                    }
-                    else {
-                        auto pixel = src[0] + src[1] * 256U + src[2] * 256U * 256U + src[3]  * 256U * 256U * 256U;
-                        pvr_write_area1_32(emu_vram, dst, pixel);
-                    }
-                    
+    Holds everything that persists between frames, so that several emulated CORE instances
+    can render concurrently from different threads. VRAM and registers are bound per thread
+    (see emu_vram / emu_regs) for the duration of a render.
+*/
+struct RefswContext
+{
+    TileContext tile; // used for serial rendering
+    TileWorkers workers;
+    uint32_t renderThreads = 1;
+    bool fixedPointRaster = false;
+
+    // region array grouped by tile position, reused between frames
+    std::vector<RegionArrayEntry> parsed;
+    std::vector<RegionArrayEntry> entries;
+    std::vector<uint32_t> groups;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> groupSizes;
+    int16_t groupOfTile[64 * 64];
+
+    // asynchronous rendering, see RenderCOREAsync
+    std::thread asyncThread;
+    std::mutex asyncLock;
+    std::condition_variable asyncWake;
+    std::condition_variable asyncDone;
+    std::atomic<bool> asyncBusy { false };  // the render thread has a frame to render
+    bool asyncQuit = false;
+    uint8_t* asyncTarget = nullptr;         // VRAM the pending frame is written back to
+    std::vector<uint8_t> asyncVram;         // only the footprint of the last frame is current
+    std::vector<uint32_t> asyncRegs;
+    std::vector<VramRange> footprint;
+
+    ~RefswContext()
+    {
+        // a pending frame is dropped, the VRAM it targets might be gone already
+        {
+            std::lock_guard<std::mutex> guard(asyncLock);
+            asyncQuit = true;
+        }
+        asyncWake.notify_one();
 
-                    dst += bpp;
-                    src += 4; // skip alpha
-                }
-            }
+        if (asyncThread.joinable()) {
+            asyncThread.join();
         }
+    }
+};
+
+RefswContext* CreateRefswContext()
+{
+    return new RefswContext();
+}
+
+void DestroyRefswContext(RefswContext* ctx)
+{
+    delete ctx;
+}
+
+void SetRenderThreads(RefswContext* ctx, uint32_t threads)
+{
+    WaitRenderCORE(ctx);
+
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    if (threads != ctx->renderThreads) {
+        ctx->renderThreads = threads;
+        ctx->workers.Resize(threads > 1 ? threads : 0);
+    }
+}
+
+void SetFixedPointRaster(RefswContext* ctx, bool enable)
+{
+    WaitRenderCORE(ctx);
+
+    ctx->fixedPointRaster = enable;
+}
+
+void GetSetupCacheStats(RefswContext* ctx, uint64_t* hits, uint64_t* misses)
+{
+    WaitRenderCORE(ctx);
+
+    *hits = ctx->tile.setupHits;
+    *misses = ctx->tile.setupMisses;
+    for (auto& tile: ctx->workers.tiles) {
+        *hits += tile->setupHits;
+        *misses += tile->setupMisses;
+    }
+}
+
+void GetVerifyStats(RefswContext* ctx, uint64_t* spans, uint64_t* mismatches)
+{
+    WaitRenderCORE(ctx);
+
+    *spans = ctx->tile.verifiedSpans;
+    *mismatches = ctx->tile.verifyMismatches;
+    for (auto& tile: ctx->workers.tiles) {
+        *spans += tile->verifiedSpans;
+        *mismatches += tile->verifyMismatches;
+    }
+}
+
+// Render a frame
+// Called on START_RENDER write
+void RenderCORE(RefswContext* ctx) {
+    {
+        auto field = SCALER_CTL.fieldselect;
+        auto interlace = SCALER_CTL.interlace;
+
+        auto base = (interlace && field) ? FB_W_SOF2 : FB_W_SOF1;
+        // printf("Rendering to %x\n", (interlace && field) ? FB_W_SOF2 : FB_W_SOF1);
+    }
+    uint32_t base = REGION_BASE;
+
+    RegionArrayEntry entry;
+    
+    RENDLOG("REFSW2LOG: 0");
+    RENDLOG("BGTAG: %08X", ISP_BACKGND_T.full);
+
+    ctx->tile.writeoutRows.clear();
+    ctx->tile.fixedPointRaster = ctx->fixedPointRaster;
+    ClearSetupCache(&ctx->tile);
+    for (auto& tile: ctx->workers.tiles) {
+        tile->writeoutRows.clear();
+        tile->fixedPointRaster = ctx->fixedPointRaster;
+        ClearSetupCache(tile.get());
+    }
+
+    if (ctx->renderThreads <= 1) {
+        // Parse region array
+        do {
+            auto step = ReadRegionArrayEntry(base, &entry);
+
+            RENDLOG("TILE: %08X %08X %08X %08X %08X %08X %08X", base, entry.control.full, entry.opaque.full, entry.opaque_mod.full, entry.trans.full, entry.trans_mod.full, entry.puncht.full);
+
+            base += step;
+
+            RenderRegionEntry(&ctx->tile, entry);
+        } while (!entry.control.last_region);
+
+        return;
+    }
+
+    // Parse region array, and group the entries by tile position, in order of first appearance
+    auto& parsed = ctx->parsed;
+    auto& entries = ctx->entries;
+    auto& groups = ctx->groups;
+    auto& order = ctx->order;
+    auto& groupSizes = ctx->groupSizes;
+    auto& groupOfTile = ctx->groupOfTile;
+
+    parsed.clear();
+    do {
+        base += ReadRegionArrayEntry(base, &entry);
+        parsed.push_back(entry);
     } while (!entry.control.last_region);
-}
\ No newline at end of file
+
+    if (NeedsRegionOrder(parsed)) {
+        for (auto& e: parsed) {
+            RenderRegionEntry(&ctx->tile, e);
+        }
+        return;
+    }
+
+    groupSizes.clear();
+    memset(groupOfTile, -1, sizeof(groupOfTile));
+    for (auto& e: parsed) {
+        auto& group = groupOfTile[e.control.tiley * 64 + e.control.tilex];
+        if (group < 0) {
+            group = groupSizes.size();
+            groupSizes.push_back(0);
+        }
+        groupSizes[group]++;
+    }
+
+    groups.resize(groupSizes.size() + 1);
+    groups[0] = 0;
+    for (size_t i = 0; i < groupSizes.size(); i++) {
+        groups[i + 1] = groups[i] + groupSizes[i];
+        groupSizes[i] = groups[i];
+    }
+
+    entries.resize(parsed.size());
+    order.resize(parsed.size());
+    for (uint32_t i = 0; i < parsed.size(); i++) {
+        auto& e = parsed[i];
+        auto slot = groupSizes[groupOfTile[e.control.tiley * 64 + e.control.tilex]]++;
+        entries[slot] = e;
+        order[slot] = i;
+    }
+
+    ctx->workers.Render(&ctx->tile, entries, groups, order);
+}
+
+/*
+    Asynchronous rendering
+
+    Frames are rendered by one render thread per context, from a private copy of the registers
+    and of the frame footprint in VRAM, so the CPU and TA are free to modify them while CORE is
+    busy. The copy is kept between frames, and only the footprint of each frame is refreshed.
+    The framebuffer rows written by the frame are copied back to VRAM by the emulation thread
+    when it observes completion, in PollRenderCORE or WaitRenderCORE. CPU writes to the same rows
+    during the render are overwritten, same as they would be by a real CORE finishing after them.
+*/
+static void AsyncRenderMain(RefswContext* ctx)
+{
+    emu_vram = ctx->asyncVram.data();
+    emu_regs = ctx->asyncRegs.data();
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(ctx->asyncLock);
+            ctx->asyncWake.wait(guard, [&] { return ctx->asyncQuit || ctx->asyncBusy.load(std::memory_order_relaxed); });
+            if (ctx->asyncQuit)
+                return;
+        }
+
+        RenderCORE(ctx);
+
+        {
+            std::lock_guard<std::mutex> guard(ctx->asyncLock);
+            ctx->asyncBusy.store(false, std::memory_order_release);
+        }
+        ctx->asyncDone.notify_one();
+    }
+}
+
+void RenderCOREAsync(RefswContext* ctx, uint8_t* vram, const uint32_t* regs)
+{
+    WaitRenderCORE(ctx);
+
+    if (!ctx->asyncThread.joinable()) {
+        ctx->asyncVram.resize(VRAM_SIZE);
+        ctx->asyncRegs.resize(pvr_RegSize / 4);
+        ctx->asyncThread = std::thread(AsyncRenderMain, ctx);
+    }
+
+    std::copy(regs, regs + pvr_RegSize / 4, ctx->asyncRegs.begin());
+
+    // The footprint is walked in the live VRAM, with the register copy
+    auto prevVram = emu_vram;
+    auto prevRegs = emu_regs;
+    emu_vram = vram;
+    emu_regs = ctx->asyncRegs.data();
+
+    ctx->footprint.clear();
+    FrameFootprint { ctx->footprint }.AddFrame();
+    for (auto& range: ctx->footprint) {
+        memcpy(&ctx->asyncVram[range.begin], &vram[range.begin], range.end - range.begin);
+    }
+
+    emu_vram = prevVram;
+    emu_regs = prevRegs;
+
+    ctx->asyncTarget = vram;
+    {
+        std::lock_guard<std::mutex> guard(ctx->asyncLock);
+        ctx->asyncBusy.store(true, std::memory_order_relaxed);
+    }
+    ctx->asyncWake.notify_one();
+}
+
+// Copy the framebuffer rows written by the last async frame to the emulated VRAM
+static void WritebackAsync(RefswContext* ctx)
+{
+    {
+        std::unique_lock<std::mutex> guard(ctx->asyncLock);
+        ctx->asyncDone.wait(guard, [&] { return !ctx->asyncBusy.load(std::memory_order_relaxed); });
+    }
+
+    auto regs = emu_regs;
+    emu_regs = ctx->asyncRegs.data();
+
+    uint32_t rowBytes = 32 * (FB_W_CTRL.fb_packmode == 0x1 ? 2 : 4);
+    auto src = ctx->asyncVram.data();
+    auto dst = ctx->asyncTarget;
+
+    auto copyRows = [&](const std::vector<uint32_t>& rows) {
+        for (auto row: rows) {
+            // 16 bit units map to contiguous bytes in the 64 bit view
+            for (uint32_t offset = 0; offset < rowBytes; offset += 2) {
+                auto addr = pvr_map32(row + offset);
+                memcpy(&dst[addr], &src[addr], 2);
+            }
+        }
+    };
+
+    copyRows(ctx->tile.writeoutRows);
+    for (auto& tile: ctx->workers.tiles) {
+        copyRows(tile->writeoutRows);
+    }
+
+    ctx->asyncTarget = nullptr;
+    emu_regs = regs;
+}
+
+bool PollRenderCORE(RefswContext* ctx)
+{
+    if (!ctx->asyncTarget) {
+        return true;
+    }
+
+    if (ctx->asyncBusy.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    WritebackAsync(ctx);
+    return true;
+}
+
+void WaitRenderCORE(RefswContext* ctx)
+{
+    if (ctx->asyncTarget) {
+        WritebackAsync(ctx);
+    }
+}
@@ -34,14 +34,22 @@ enum RenderMode {
     RM_MODIFIER,
 };
 
+// Tag status of a tile, as bitmasks with one word per row (bit x of a word is pixel x)
 struct TagState {
-    union {
-        struct {
-            bool valid: 1;
-            bool rendered: 1;
-        };
-        uint8_t raw;
-    };
+    uint32_t valid[32];
+    uint32_t rendered[32];
+
+    void Clear(bool isValid) {
+        for (int y = 0; y < 32; y++) {
+            valid[y] = isValid ? ~0u : 0;
+            rendered[y] = 0;
+        }
+    }
+
+    bool Valid(uint32_t index) const { return (valid[index / 32] >> (index % 32)) & 1; }
+    bool Rendered(uint32_t index) const { return (rendered[index / 32] >> (index % 32)) & 1; }
+
+    void SetValid(uint32_t index) { valid[index / 32] |= 1u << (index % 32); }
 };
 
 #define PARAMETER_TAG_SORT_MASK 0x00FFFFFF
@@ -8,6 +8,7 @@
 */
 // #include "license/bsd"
 
+#include <algorithm>
 #include <cmath>
 #include <memory>
 #include <set>
@@ -20,19 +21,16 @@
 #include "TexUtils.h"
 #include <cassert>
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #define die(msg) assert(!msg)
 
 // #define STB_IMAGE_WRITE_IMPLEMENTATION
 // #include "deps/stb/stb_image_write.h"
 
-extern uint8_t* emu_vram;
-
-TagState       tagStatus[MAX_RENDER_PIXELS];
-parameter_tag_t tagBuffer[2] [MAX_RENDER_PIXELS];
-StencilType     stencilBuffer[MAX_RENDER_PIXELS];
-uint32_t             colorBuffer1 [MAX_RENDER_PIXELS];
-uint32_t             colorBuffer2 [MAX_RENDER_PIXELS];
-ZType           depthBuffer[3] [MAX_RENDER_PIXELS];
+extern thread_local uint8_t* emu_vram;
 
 constexpr const uint32_t tagBufferA = 0;
 constexpr const uint32_t tagBufferB = 1;
@@ -40,6 +38,12 @@ constexpr const uint32_t depthBufferA = 0;
 constexpr const uint32_t depthBufferB = 1;
 constexpr const uint32_t depthBufferC = 2;
 
+// Block size of the hierarchical traversal in RasterizeTriangle
+constexpr const int RASTER_BLOCK = 8;
+
+// Sub-pixel precision of the fixed point rasterizer
+constexpr const int RASTER_SUBPIXEL_BITS = 4;
+
 static float mmin(float a, float b, float c, float d)
 {
     float rv = std::min(a, b);
@@ -64,108 +68,141 @@ float  mask_w(float w) {
 }
 
 #if defined(__CLANG__) || defined(__GNUC__)
-#define always_inline always_inline
+#define always_inline __attribute__((always_inline))
 #else
 #define always_inline __forceinline
 #endif
 
-void ClearBuffers(uint32_t paramValue, float depthValue, uint32_t stencilValue)
+static inline always_inline int CountTrailingZeros(uint32_t v)
 {
-    auto zb = depthBuffer[depthBufferA];
-    auto stencil = stencilBuffer;
-    auto pb = tagBuffer[tagBufferA];;
-
-    for (int i = 0; i < MAX_RENDER_PIXELS; i++) {
-        zb[i] = mask_w(depthValue);
-        stencil[i] = stencilValue;
-        pb[i] = paramValue;
-        tagStatus[i] = { true, false };
+#if defined(__GNUC__)
+    return __builtin_ctz(v);
+#else
+    int n = 0;
+    while (!(v & 1)) {
+        v >>= 1;
+        n++;
     }
+    return n;
+#endif
 }
 
-void ClearParamStatusBuffer() {
-    auto ts = tagStatus;
+// Bits x0 .. x1 of a row mask
+static inline always_inline uint32_t SpanMask(int x0, int x1)
+{
+    return (~0u >> (31 - x1)) & (~0u << x0);
+}
+
+void ClearBuffers(TileContext* tile, uint32_t paramValue, float depthValue, uint32_t stencilValue)
+{
+    auto zb = tile->depthBuffer[depthBufferA];
+    auto pb = tile->tagBuffer[tagBufferA];;
+
+    tile->stencil.Clear(stencilValue);
+    tile->hizValid = false;
+
+    tile->tagStatus.Clear(true);
 
     for (int i = 0; i < MAX_RENDER_PIXELS; i++) {
-        ts[i] = { false, false };
+        zb[i] = mask_w(depthValue);
+        pb[i] = paramValue;
     }
 }
 
-void PeelBuffersPTInitial(float depthValue) {
-    memcpy(depthBuffer[depthBufferC], depthBuffer[depthBufferA], sizeof(ZType) * MAX_RENDER_PIXELS);
-    auto ts = tagStatus;
+void ClearParamStatusBuffer(TileContext* tile) {
+    tile->tagStatus.Clear(false);
+}
 
-    for (int i = 0; i < MAX_RENDER_PIXELS; i++) {
-        ts[i] = { false, false };
-        stencilBuffer[i] = 0;
-    }
+void PeelBuffersPTInitial(TileContext* tile, float depthValue) {
+    memcpy(tile->depthBuffer[depthBufferC], tile->depthBuffer[depthBufferA], sizeof(ZType) * MAX_RENDER_PIXELS);
+    tile->tagStatus.Clear(false);
+    tile->stencil.Clear(0);
 }
 
-void PeelBuffersPT() {
-    memcpy(depthBuffer[depthBufferB], depthBuffer[depthBufferA], sizeof(ZType) * MAX_RENDER_PIXELS);
-    memcpy(tagBuffer[tagBufferB], tagBuffer[tagBufferA], sizeof(parameter_tag_t) * MAX_RENDER_PIXELS);
+void PeelBuffersPT(TileContext* tile) {
+    memcpy(tile->depthBuffer[depthBufferB], tile->depthBuffer[depthBufferA], sizeof(ZType) * MAX_RENDER_PIXELS);
+    memcpy(tile->tagBuffer[tagBufferB], tile->tagBuffer[tagBufferA], sizeof(parameter_tag_t) * MAX_RENDER_PIXELS);
 }
 
-void SetTagToMax()
+void SetTagToMax(TileContext* tile)
 {
-    memset(tagBuffer[tagBufferA], 0xFF, sizeof(tagBuffer[tagBufferA]));
+    memset(tile->tagBuffer[tagBufferA], 0xFF, sizeof(tile->tagBuffer[tagBufferA]));
 }
-void PeelBuffers(float depthValue, uint32_t stencilValue)
+void PeelBuffers(TileContext* tile, float depthValue, uint32_t stencilValue)
 {
-    memcpy(depthBuffer[depthBufferB], depthBuffer[depthBufferA], sizeof(ZType) * MAX_RENDER_PIXELS);
-    memcpy(tagBuffer[tagBufferB], tagBuffer[tagBufferA], sizeof(parameter_tag_t) * MAX_RENDER_PIXELS);
+    memcpy(tile->depthBuffer[depthBufferB], tile->depthBuffer[depthBufferA], sizeof(ZType) * MAX_RENDER_PIXELS);
+    memcpy(tile->tagBuffer[tagBufferB], tile->tagBuffer[tagBufferA], sizeof(parameter_tag_t) * MAX_RENDER_PIXELS);
+
 
+    auto zb = tile->depthBuffer[depthBufferA];
 
-    auto zb = depthBuffer[depthBufferA];
-    auto stencil = stencilBuffer;
+    tile->tagStatus.Clear(false);
+    tile->stencil.Clear(stencilValue);
+    tile->hizValid = false;
 
     for (int i = 0; i < MAX_RENDER_PIXELS; i++) {
         zb[i] = mask_w(depthValue);    // set the "closest" test to furthest value possible
-        tagStatus[i] = { false, false };
-        stencil[i] = stencilValue;
     }
 }
 
 
-void SummarizeStencilOr() {
-    auto stencil = stencilBuffer;
+void SummarizeStencilOr(TileContext* tile) {
+    auto& stencil = tile->stencil;
 
-    // post movdol merge INSIDE
-    for (int i = 0; i < MAX_RENDER_PIXELS; i++) {
-        if (stencil[i] & 0b100) {
-            stencil[i] |= (stencil[i] >>1);
-            stencil[i] &=0b001; // keep only status bit
-        }
+    // post movdol merge INSIDE, for the touched pixels
+    for (int y = 0; y < MAX_RENDER_HEIGHT; y++) {
+        auto touched = stencil.touched[y];
+        stencil.inside[y] |= stencil.parity[y] & touched;
+        stencil.parity[y] &= ~touched; // keep only status bit
+        stencil.touched[y] = 0;
     }
 }
 
-void SummarizeStencilAnd() {
-    auto stencil = stencilBuffer;
+void SummarizeStencilAnd(TileContext* tile) {
+    auto& stencil = tile->stencil;
 
-    for (int i = 0; i < MAX_RENDER_PIXELS; i++) {
-        // post movdol merge OUTSIDE
-        if (stencil[i] & 0b100) {
-            stencil[i] &= (stencil[i] >>1);
-            stencil[i] &=0b001; // keep only status bit
-        }
+    // post movdol merge OUTSIDE, for the touched pixels
+    for (int y = 0; y < MAX_RENDER_HEIGHT; y++) {
+        auto touched = stencil.touched[y];
+        stencil.inside[y] &= stencil.parity[y] | ~touched;
+        stencil.parity[y] &= ~touched; // keep only status bit
+        stencil.touched[y] = 0;
     }
 }
 
-bool MoreToDraw;
-void ClearMoreToDraw()
+void ClearMoreToDraw(TileContext* tile)
 {
-    MoreToDraw = 0;
+    tile->MoreToDraw = 0;
 }
 
-bool GetMoreToDraw()
+bool GetMoreToDraw(TileContext* tile)
 {
-    return MoreToDraw;
+    return tile->MoreToDraw;
+}
+
+// Whether a pixel with a valid (or rendered) tag has the shadow bit set.
+// Only those pixels read the stencil, see InVolume in RenderParamTags
+bool HasShadowedTags(TileContext* tile, bool rendered)
+{
+    auto pb = tile->tagBuffer[tagBufferA];
+
+    for (int y = 0; y < 32; y++) {
+        uint32_t TagValid = rendered ? tile->tagStatus.rendered[y] : tile->tagStatus.valid[y];
+
+        for (; TagValid; TagValid &= TagValid - 1) {
+            ISP_BACKGND_T_type t { .full = pb[y * 32 + CountTrailingZeros(TagValid)] };
+            if (t.shadow)
+                return true;
+        }
+    }
+
+    return false;
 }
 
     // Render to ACCUM from TAG buffer
 // TAG holds references to trianes, ACCUM is the tile framebuffer
 template<RenderMode rm>
-void RenderParamTags(int tileX, int tileY) {
+void RenderParamTags(TileContext* tile, int tileX, int tileY, uint32_t rows) {
     float halfpixel = HALF_OFFSET.tsp_pixel_half_offset ? 0.5f : 0;
     taRECT rect;
     rect.left = tileX;
@@ -173,58 +210,87 @@ void RenderParamTags(int tileX, int tileY) {
     rect.bottom = rect.top + 32;
     rect.right = rect.left + 32;
 
-    for (int y = 0; y < 32; y++) {
-        for (int x = 0; x < 32; x++) {
-            auto index = y * 32 + x;
-            auto tag =  tagBuffer[tagBufferA][index];
-            ISP_BACKGND_T_type t { .full = tag };
-            bool InVolume = (stencilBuffer[index] & 0b001) == 0b001 && t.shadow;
-            bool TagValid = tagStatus[index].valid;
-            
-            if (rm == RM_PUNCHTHROUGH_MV) {
-                if (!InVolume) {
-                    continue;
-                } else {
-                    TagValid = tagStatus[index].rendered;
-                }
+    // Tag, volume and validity of a pixel for this pass
+    auto classify = [tile](uint32_t index, ISP_BACKGND_T_type& t, bool& InVolume) {
+        t.full = tile->tagBuffer[tagBufferA][index];
+        InVolume = tile->stencil.Inside(index) && t.shadow;
+        bool TagValid = tile->tagStatus.Valid(index);
+
+        if (rm == RM_PUNCHTHROUGH_MV) {
+            if (!InVolume) {
+                return false;
+            } else {
+                TagValid = tile->tagStatus.Rendered(index);
             }
+        }
 
-            if (rm == RM_PUNCHTHROUGH_PASS0 || rm == RM_PUNCHTHROUGH_PASSN) {
-                InVolume = false;
+        if (rm == RM_PUNCHTHROUGH_PASS0 || rm == RM_PUNCHTHROUGH_PASSN) {
+            InVolume = false;
+        }
+
+        return TagValid;
+    };
+
+    for (; rows; rows &= rows - 1) {
+        int y = CountTrailingZeros(rows);
+
+        // Pixels that may be shaded, empty rows are skipped
+        uint32_t candidates = rm == RM_PUNCHTHROUGH_MV ? tile->tagStatus.rendered[y] & tile->stencil.inside[y] : tile->tagStatus.valid[y];
+
+        // SPAN SORTER: runs of valid pixels with the same tag and volume are shaded as one span
+        while (candidates) {
+            int x0 = CountTrailingZeros(candidates);
+
+            ISP_BACKGND_T_type t;
+            bool InVolume;
+            if (!classify(y * 32 + x0, t, InVolume)) {
+                candidates &= candidates - 1;
+                continue;
             }
 
-            if (TagValid) {
-                const auto& Entry = GetFpuEntry(&rect, rm, t);
-                auto invW = Entry.ips.invW.Ip(x + halfpixel, y + halfpixel);
-                bool AlphaTestPassed = PixelFlush_tsp(rm == RM_PUNCHTHROUGH_PASS0 || rm == RM_PUNCHTHROUGH_PASSN, &Entry, x + halfpixel, y + halfpixel, index, invW, InVolume, t);
-
-                if (rm == RM_PUNCHTHROUGH_PASS0 || rm == RM_PUNCHTHROUGH_PASSN) {
-                    // can only happen when rm == RM_PUNCHTHROUGH
-                    if (!AlphaTestPassed) {
-                        MoreToDraw = true;
-                        // Feedback Channel
-                        depthBuffer[depthBufferA][index] = depthBuffer[depthBufferC][index];
-                    } else {
-                        tagStatus[index].rendered = true;
-                        tagStatus[index].valid = false;
-                    }
-                }
+            int x1 = x0;
+            while (x1 < 31 && (candidates & (1u << (x1 + 1)))) {
+                ISP_BACKGND_T_type t2;
+                bool InVolume2;
+                if (!classify(y * 32 + x1 + 1, t2, InVolume2) || t2.full != t.full || InVolume2 != InVolume)
+                    break;
+                x1++;
+            }
+
+            uint32_t span = SpanMask(x0, x1);
+            candidates &= ~span;
 
-                if (rm == RM_TRANSLUCENT_PRESORT) {
-                    tagStatus[index].valid = false;
+            const auto& Entry = GetFpuEntry(tile, &rect, t, InVolume);
+            uint32_t AlphaTestPassed = ShadeSpan(tile, rm == RM_PUNCHTHROUGH_PASS0 || rm == RM_PUNCHTHROUGH_PASSN, &Entry, halfpixel, y, x0, x1, InVolume, t);
+
+            if (rm == RM_PUNCHTHROUGH_PASS0 || rm == RM_PUNCHTHROUGH_PASSN) {
+                // can only happen when rm == RM_PUNCHTHROUGH
+                for (uint32_t failed = span & ~AlphaTestPassed; failed; failed &= failed - 1) {
+                    auto index = y * 32 + CountTrailingZeros(failed);
+                    tile->MoreToDraw = true;
+                    // Feedback Channel
+                    tile->depthBuffer[depthBufferA][index] = tile->depthBuffer[depthBufferC][index];
+                    tile->hizValid = false;
                 }
+
+                tile->tagStatus.rendered[y] |= span & AlphaTestPassed;
+                tile->tagStatus.valid[y] &= ~(span & AlphaTestPassed);
+            }
+
+            if (rm == RM_TRANSLUCENT_PRESORT) {
+                tile->tagStatus.valid[y] &= ~span;
             }
         }
     }
 }
 
-template void RenderParamTags<RM_OPAQUE>(int tileX, int tileY);
-template void RenderParamTags<RM_PUNCHTHROUGH_PASS0>(int tileX, int tileY);
-template void RenderParamTags<RM_PUNCHTHROUGH_PASSN>(int tileX, int tileY);
-template void RenderParamTags<RM_PUNCHTHROUGH_MV>(int tileX, int tileY);
-template void RenderParamTags<RM_TRANSLUCENT_AUTOSORT>(int tileX, int tileY);
-template void RenderParamTags<RM_TRANSLUCENT_PRESORT>(int tileX, int tileY);
-template void RenderParamTags<RM_MODIFIER>(int tileX, int tileY);
+template void RenderParamTags<RM_OPAQUE>(TileContext* tile, int tileX, int tileY, uint32_t rows);
+template void RenderParamTags<RM_PUNCHTHROUGH_PASS0>(TileContext* tile, int tileX, int tileY, uint32_t rows);
+template void RenderParamTags<RM_PUNCHTHROUGH_PASSN>(TileContext* tile, int tileX, int tileY, uint32_t rows);
+template void RenderParamTags<RM_PUNCHTHROUGH_MV>(TileContext* tile, int tileX, int tileY, uint32_t rows);
+template void RenderParamTags<RM_TRANSLUCENT_AUTOSORT>(TileContext* tile, int tileX, int tileY, uint32_t rows);
+template void RenderParamTags<RM_TRANSLUCENT_PRESORT>(TileContext* tile, int tileX, int tileY, uint32_t rows);
+template void RenderParamTags<RM_MODIFIER>(TileContext* tile, int tileX, int tileY, uint32_t rows);
 
 #define vert_packed_color_(to,src) \
 	{ \
@@ -329,29 +395,202 @@ uint32_t decode_pvr_vertices(DrawParameters* params, pvr32addr_t base, uint32_t
     return base;
 }
 
-struct {
-    FpuEntry entry;
-    uint32_t      tag;
-} fpuCache[32];
+// decode the isp word and vertex positions of an object, for rasterization
+// the tsp/tcw words and the vertex attributes are left undecoded, GetFpuEntry decodes them on first TSP use
+uint32_t decode_pvr_positions(DrawParameters* params, pvr32addr_t base, uint32_t skip, uint32_t two_volumes, Vertex* vtx, int count)
+{
+    params->isp.full=vri(emu_vram, base);
+
+    base += two_volumes ? 20 : 12;
 
-const FpuEntry& GetFpuEntry(taRECT *rect, RenderMode render_mode, ISP_BACKGND_T_type core_tag)
+    for (int i = 0; i < count; i++) {
+        vtx[i].x=vrf(emu_vram, base);
+        vtx[i].y=vrf(emu_vram, base+4);
+        vtx[i].z=vrf(emu_vram, base+8);
+        base += (3 + skip * (two_volumes+1)) * 4;
+    }
+
+    return base;
+}
+
+static void ResolveTspPipeline(TspPipeline* pipeline, const DrawParameters* params, uint32_t two_voume_index);
+
+// The screen space setup of a tag, from the setup cache of the frame. Volume 1 is set up only when asked for
+static const FrameSetup& GetFrameSetup(TileContext* tile, ISP_BACKGND_T_type core_tag, bool volume1)
 {
-    if (fpuCache[core_tag.param_offs_in_words & 31].tag == core_tag.full) {
-        return fpuCache[core_tag.param_offs_in_words & 31].entry;
+    if (tile->setupCache.empty()) {
+        tile->setupCache.resize(SETUP_CACHE_SIZE);
     }
-    FpuEntry &entry = fpuCache[core_tag.param_offs_in_words & 31].entry;
-    Vertex vtx[3];
-    decode_pvr_vertices(&entry.params, PARAM_BASE + core_tag.param_offs_in_words * 4, core_tag.skip, core_tag.shadow & ~FPU_SHAD_SCALE.intensity_shadow, vtx, 3, core_tag.tag_offset);
 
-    entry.ips.Setup(rect, &entry.params, vtx[0], vtx[1], vtx[2], core_tag.shadow & ~FPU_SHAD_SCALE.intensity_shadow);
+    auto& setup = tile->setupCache[(core_tag.full * 2654435761u) >> 22];
+    static_assert(SETUP_CACHE_SIZE == 1024, "the index above takes 10 bits");
+
+    if (setup.tag == core_tag.full && setup.frame == tile->setupFrame) {
+        tile->setupHits++;
+    } else {
+        tile->setupMisses++;
+
+        setup.tag = core_tag.full;
+        setup.frame = tile->setupFrame;
+        setup.twoVolumes = core_tag.shadow & ~FPU_SHAD_SCALE.intensity_shadow;
+        setup.volume1Ready = false;
 
-    fpuCache[core_tag.param_offs_in_words & 31].tag = core_tag.full;
+        decode_pvr_vertices(&setup.params, PARAM_BASE + core_tag.param_offs_in_words * 4, core_tag.skip, setup.twoVolumes, setup.vtx, 3, core_tag.tag_offset);
+        setup.ips.Setup(&setup.params, setup.vtx[0], setup.vtx[1], setup.vtx[2]);
+        ResolveTspPipeline(&setup.pipeline[0], &setup.params, 0);
+    }
+
+    if (volume1 && setup.twoVolumes && !setup.volume1Ready) {
+        setup.ips.SetupVolume(&setup.params, setup.vtx[0], setup.vtx[1], setup.vtx[2], 1);
+        ResolveTspPipeline(&setup.pipeline[1], &setup.params, 1);
+
+        setup.volume1Ready = true;
+    }
+
+    return setup;
+}
 
-    return fpuCache[core_tag.param_offs_in_words & 31].entry ;
+static uint32_t TriangleHash(uint32_t tag)
+{
+    uint32_t h = tag * 2654435761u;
+    return h ^ (h >> 16);
 }
 
-void ClearFpuCache() {
-    memset(fpuCache, 0, sizeof(fpuCache));
+// Double the triangle index of a tile, keeping it at most half full
+static void GrowTriangleIndex(TileContext* tile)
+{
+    auto& index = tile->triangleIndex;
+    index.assign(std::max<size_t>(256, index.size() * 2), 0);
+
+    uint32_t mask = index.size() - 1;
+    for (uint32_t i = 0; i < tile->triangles.size(); i++) {
+        uint32_t slot = TriangleHash(tile->triangles[i].tag) & mask;
+        while (index[slot] != 0)
+            slot = (slot + 1) & mask;
+        index[slot] = i + 1;
+    }
+}
+
+// The triangle table entry of a tag, added with nothing set up when the tile hasn't met it yet
+static TileTriangle& GetTileTriangle(TileContext* tile, uint32_t tag, bool* added)
+{
+    if (tile->triangles.size() * 2 >= tile->triangleIndex.size())
+        GrowTriangleIndex(tile);
+
+    auto& index = tile->triangleIndex;
+    uint32_t mask = index.size() - 1;
+
+    for (uint32_t slot = TriangleHash(tag) & mask; ; slot = (slot + 1) & mask) {
+        if (index[slot] == 0) {
+            index[slot] = tile->triangles.size() + 1;
+            tile->triangles.emplace_back();
+
+            auto& triangle = tile->triangles.back();
+            triangle.tag = tag;
+            triangle.ready = false;
+            triangle.rasterZ = false;
+            triangle.volume1Ready = false;
+
+            *added = true;
+            return triangle;
+        }
+
+        auto& triangle = tile->triangles[index[slot] - 1];
+        if (triangle.tag == tag) {
+            *added = false;
+            return triangle;
+        }
+    }
+}
+
+// Add a tag to the triangle table of the tile when it is rasterized, with the Z plane of the rasterizer as invW.
+// Odd strip triangles are rasterized with their first two vertices swapped, while invW is set up in strip
+// order, so their Z plane isn't bit-identical and invW comes from the frame setup instead
+static void AddTileTriangle(TileContext* tile, parameter_tag_t tag, const PlaneStepper3& Z)
+{
+    ISP_BACKGND_T_type core_tag;
+    core_tag.full = tag;
+
+    bool added;
+    auto& triangle = GetTileTriangle(tile, tag, &added);
+
+    if (!triangle.ready && !triangle.rasterZ && !(core_tag.tag_offset & 1)) {
+        triangle.entry.ips.invW = Z;
+        triangle.rasterZ = true;
+    }
+}
+
+// The setup of a tag for the TSP, from the triangle table of the tile. Tags are added when they are rasterized,
+// or the first time the TSP meets them for the background and z_keep tags. The rest of the setup is moved to
+// the tile from the frame's screen space setup on first use, and volume 1 once a span inside the volume needs it
+const FpuEntry& GetFpuEntry(TileContext* tile, taRECT *rect, ISP_BACKGND_T_type core_tag, bool InVolume)
+{
+    bool added;
+    auto& triangle = GetTileTriangle(tile, core_tag.full, &added);
+    FpuEntry &entry = triangle.entry;
+
+    if (!triangle.ready) {
+        const auto& setup = GetFrameSetup(tile, core_tag, false);
+
+        entry.params = setup.params;
+        entry.ips.ToTile(setup.ips, rect, &entry.params, setup.vtx[0], 0);
+        entry.pipeline[0] = setup.pipeline[0];
+
+        if (!triangle.rasterZ)
+            entry.ips.invW = setup.ips.invW.ToTile(rect, setup.vtx[0]);
+
+#if defined(REFSW_VERIFY_TSP)
+        // The Z plane of the rasterizer must be the invW plane of the frame setup
+        auto invW = setup.ips.invW.ToTile(rect, setup.vtx[0]);
+        if (memcmp(&invW, &entry.ips.invW, sizeof(invW)) != 0) {
+            tile->verifyMismatches++;
+            die("Missmatch");
+        }
+#endif
+
+        triangle.ready = true;
+    }
+
+    bool twoVolumes = core_tag.shadow & ~FPU_SHAD_SCALE.intensity_shadow;
+    if (InVolume && twoVolumes && !triangle.volume1Ready) {
+        const auto& setup = GetFrameSetup(tile, core_tag, true);
+
+        entry.ips.ToTile(setup.ips, rect, &entry.params, setup.vtx[0], 1);
+        entry.pipeline[1] = setup.pipeline[1];
+
+        triangle.volume1Ready = true;
+    }
+
+    return entry;
+}
+
+// Empty the triangle table, for a new region array entry
+void ClearFpuCache(TileContext* tile) {
+    auto& index = tile->triangleIndex;
+    uint32_t mask = index.size() - 1;
+
+    // Every tag in the table is removed, so probe chains don't need to be kept
+    for (uint32_t i = 0; i < tile->triangles.size(); i++) {
+        uint32_t slot = TriangleHash(tile->triangles[i].tag) & mask;
+        while (index[slot] != i + 1)
+            slot = (slot + 1) & mask;
+        index[slot] = 0;
+    }
+
+    tile->triangles.clear();
+}
+
+void ClearSetupCache(TileContext* tile) {
+    // frame 0 is never used, so zeroed entries are never hits
+    if (++tile->setupFrame == 0) {
+        tile->setupCache.clear();
+        tile->setupFrame = 1;
+    }
+
+    tile->setupHits = 0;
+    tile->setupMisses = 0;
+    tile->verifiedSpans = 0;
+    tile->verifyMismatches = 0;
 }
 
 // this is disabled for now, as it breaks game scenes
@@ -363,16 +602,74 @@ inline always_inline bool IsTopLeft(float x, float y) {
 }
 
 
+// One half-edge of a triangle or quad, evaluated the same way as the per pixel coverage test
+struct HalfEdge {
+    float C, DX, DY;
+    bool T;
+
+    inline always_inline bool Inside(float x_ps, float y_ps) const {
+        float Xhs = C + DX * y_ps - DY * x_ps;
+        return Xhs > 0 || (T && Xhs == 0);
+    }
+};
+
+// All four edges are horizontal or vertical
+inline always_inline bool IsAxisAligned(const HalfEdge* edges) {
+    bool aligned = true;
+    for (int i = 0; i < 4; i++)
+        aligned = aligned && (edges[i].DX == 0 || edges[i].DY == 0);
+    return aligned;
+}
+
+// Direction a half-edge test moves in along an axis: 1 if it can only turn false, -1 if it can only turn true
+inline always_inline int EdgeDir(float slope) {
+    return slope > 0 ? 1 : slope < 0 ? -1 : 0;
+}
+
+// Small enough that the edge functions can't overflow
+inline always_inline bool IsClippable(float v) {
+    return fabsf(v) < 1e18f;
+}
+
+// Narrow [lo, hi] to the indices where a monotonic inside test holds, see EdgeDir for dir
+// Returns false if it holds nowhere in the range
+template<typename F>
+inline always_inline bool NarrowToInside(int dir, int& lo, int& hi, F inside) {
+    if (dir == 0)
+        return inside(lo);
+
+    if (dir > 0) {
+        if (!inside(lo))
+            return false;
+        int a = lo, b = hi;
+        while (a < b) {
+            int mid = (a + b + 1) / 2;
+            if (inside(mid)) a = mid; else b = mid - 1;
+        }
+        hi = a;
+    } else {
+        if (!inside(hi))
+            return false;
+        int a = lo, b = hi;
+        while (a < b) {
+            int mid = (a + b) / 2;
+            if (inside(mid)) b = mid; else a = mid + 1;
+        }
+        lo = b;
+    }
+    return true;
+}
+
+
 // Depth processing for a pixel -- render_mode 0: OPAQ, 1: PT, 2: TRANS
 template<RenderMode render_mode>
-inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis, float x, float y, float invW, uint32_t index, parameter_tag_t tag)
+inline always_inline void PixelFlush_isp(TileContext* tile, uint32_t depth_mode, uint32_t ZWriteDis, float x, float y, float invW, uint32_t index, parameter_tag_t tag)
 {
-    auto pb = tagBuffer[tagBufferA] + index;
-    auto ts = tagStatus + index;
-    auto pb2 = tagBuffer[tagBufferB] + index;
-    auto zb = depthBuffer[depthBufferA] + index;
-    auto zb2 = depthBuffer[depthBufferB] + index;
-    auto stencil = stencilBuffer + index;
+    auto pb = tile->tagBuffer[tagBufferA] + index;
+    auto& ts = tile->tagStatus;
+    auto pb2 = tile->tagBuffer[tagBufferB] + index;
+    auto zb = tile->depthBuffer[depthBufferA] + index;
+    auto zb2 = tile->depthBuffer[depthBufferB] + index;
 
     auto mode = depth_mode;
         
@@ -394,7 +691,7 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
         // less or equal
         case 3: if (invW > *zb) {
             if (render_mode == RM_TRANSLUCENT_AUTOSORT) {
-                MoreToDraw = true;
+                tile->MoreToDraw = true;
             }
             RENDLOG("ZFAIL");
             return;
@@ -419,7 +716,7 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
                 *zb = mask_w(invW);
             }
             *pb = tag;
-            ts->valid = 1;
+            ts.SetValid(index);
             RENDLOG("RENDERED: %f", *zb);
         }
         break;
@@ -428,12 +725,10 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
         {
             // Flip on Z pass
 
-            RENDLOG("STENCIL: %08X", *stencil);
-
-            *stencil ^= 0b0010;
+            RENDLOG("STENCIL: %08X", tile->stencil.Pixel(index));
 
             // This pixel has valid stencil for summary
-            *stencil |= 0b100;
+            tile->stencil.Flip(index / 32, 1u << (index % 32));
         }
         break;
 
@@ -443,13 +738,13 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
             *pb = tag;
 
             RENDLOG("RENDERED");
-            ts->valid = 1;
+            ts.SetValid(index);
         }
         break;
         // PT
         case RM_PUNCHTHROUGH_PASSN:
         {
-            if (ts->rendered) {
+            if (ts.Rendered(index)) {
                 RENDLOG("ALREADY_DRAWN");
                 return;
             }
@@ -468,7 +763,7 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
                 }
             }
             
-            MoreToDraw = true;
+            tile->MoreToDraw = true;
 
             *zb = mask_w(invW);
             *pb = tag;
@@ -484,7 +779,7 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
                 *zb = mask_w(invW);
             }
             *pb = tag;
-            ts->valid = true;
+            ts.SetValid(index);
             RENDLOG("RENDERED: %f", *zb);
         }
         break;
@@ -514,11 +809,11 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
                     return;
                 }
                 
-                if (ts->valid) {
+                if (ts.Valid(index)) {
                     auto tagPending = *pb;
                     // if tag is later than the current pending, skip
                     if ((tag & PARAMETER_TAG_SORT_MASK) > (tagPending & PARAMETER_TAG_SORT_MASK)) {
-                        MoreToDraw = true;
+                        tile->MoreToDraw = true;
                         RENDLOG("ZFAIL6");
                         return;
                     }
@@ -528,10 +823,10 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
 
             *zb = mask_w(invW);
 
-            if (ts->valid) {
-                MoreToDraw = true;
+            if (ts.Valid(index)) {
+                tile->MoreToDraw = true;
             }
-            ts->valid = true;
+            ts.SetValid(index);
             *pb = tag;
             RENDLOG("RENDERED");
         }
@@ -541,31 +836,390 @@ inline always_inline void PixelFlush_isp(uint32_t depth_mode, uint32_t ZWriteDis
     }
 }
 
-// Rasterize a single triangle to ISP (or ISP+TSP for PT)
-template<RenderMode render_mode>
-void RasterizeTriangle(DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area)
+#if defined(__GNUC__)
+// 8 pixel vectors for the ISP row kernel, lowered to SSE/AVX on x86 and NEON on ARM
+#define REFSW_SIMD 1
+
+// The vector helpers are all internal, so their ABI doesn't matter
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+typedef float    f32x8 __attribute__((vector_size(32)));
+typedef int32_t  i32x8 __attribute__((vector_size(32)));
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef double   f64x8 __attribute__((vector_size(64)));
+
+static inline always_inline uint32_t LaneBits(const i32x8& mask) {
+#if defined(__AVX__)
+    return _mm256_movemask_ps((__m256)mask);
+#elif defined(__SSE2__)
+    __m128 lo, hi;
+    memcpy(&lo, &mask, sizeof(lo));
+    memcpy(&hi, (uint8_t*)&mask + sizeof(lo), sizeof(hi));
+    return _mm_movemask_ps(lo) | (_mm_movemask_ps(hi) << 4);
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < 8; i++)
+        bits |= (mask[i] & 1) << i;
+    return bits;
+#endif
+}
+
+template<typename T>
+static inline always_inline T Select(const i32x8& mask, const T& a, const T& b) {
+    return (T)(((i32x8)a & mask) | ((i32x8)b & ~mask));
+}
+
+// Lanes passing the depth compare of PixelFlush_isp, with the same NaN behaviour
+static inline always_inline i32x8 DepthPass(uint32_t mode, const f32x8& invW, const f32x8& zb) {
+    switch(mode) {
+        case 0: return i32x8{};
+        case 1: return ~(invW >= zb);
+        case 2: return invW == zb;
+        case 3: return ~(invW > zb);
+        case 4: return ~(invW <= zb);
+        case 5: return ~(invW == zb);
+        case 6: return ~(invW < zb);
+        default: return ~i32x8{};
+    }
+}
+#endif
+
+// Depth compare mode of the ISP for a render mode, see PixelFlush_isp
+constexpr uint32_t IspDepthMode(RenderMode render_mode, uint32_t depth_mode)
+{
+    if (render_mode == RM_PUNCHTHROUGH_PASS0 || render_mode == RM_PUNCHTHROUGH_PASSN || render_mode == RM_MODIFIER)
+        return 6;
+    else if (render_mode == RM_TRANSLUCENT_AUTOSORT)
+        return 3;
+    else
+        return depth_mode;
+}
+
+// Whether the ISP writes depth buffer A for a render mode
+constexpr bool IspWritesDepth(RenderMode render_mode, bool ZWriteDis)
+{
+    return render_mode == RM_PUNCHTHROUGH_PASS0 || render_mode == RM_PUNCHTHROUGH_PASSN ||
+           render_mode == RM_TRANSLUCENT_AUTOSORT ||
+           ((render_mode == RM_OPAQUE || render_mode == RM_TRANSLUCENT_PRESORT) && !ZWriteDis);
+}
+
+// Whether the ISP keeps the hierarchical Z a lower bound of the depth buffer. True when it doesn't
+// write depth, or only writes values that passed a greater (or equal) compare against the old ones.
+constexpr bool HizPreserved(RenderMode render_mode, uint32_t depth_mode, bool ZWriteDis)
+{
+    uint32_t mode = IspDepthMode(render_mode, depth_mode);
+
+    return !IspWritesDepth(render_mode, ZWriteDis) || mode == 0 || mode == 2 || mode == 4 || mode == 6;
+}
+
+// Whether invW can't overflow to inf or NaN anywhere in the tile
+static bool IsDepthPlaneSafe(const PlaneStepper3& Z)
+{
+    return fabsf(Z.ddx) * 32 + fabsf(Z.ddy) * 32 + fabsf(Z.c) < 1e30f;
+}
+
+// Rebuild the per block minimum of depth buffer A. Blocks with a NaN depth can't reject anything.
+static void RebuildHiz(TileContext* tile)
 {
-    const int stride_bytes = STRIDE_PIXEL_OFFSET * 4;
-    //Plane equation
+    auto zb = tile->depthBuffer[depthBufferA];
+
+    for (int by = 0; by < 32 / RASTER_BLOCK; by++) {
+        for (int bx = 0; bx < 32 / RASTER_BLOCK; bx++) {
+            float zmin = INFINITY;
+            bool nan = false;
+
+            for (int y = by * RASTER_BLOCK; y < (by + 1) * RASTER_BLOCK; y++) {
+                for (int x = bx * RASTER_BLOCK; x < (bx + 1) * RASTER_BLOCK; x++) {
+                    float z = zb[y * 32 + x];
+                    nan |= std::isnan(z);
+                    zmin = std::min(zmin, z);
+                }
+            }
+
+            tile->hizMin[by][bx] = nan ? -INFINITY : zmin;
+        }
+    }
+
+    tile->hizValid = true;
+}
+
+// Whether the depth compare fails for every pixel of [x0, x1] x [y0, y1], for the opaque and punch
+// through passes with a greater (or equal) compare. The plane is bounded at the corners of each block
+// in double precision, with a margin well above the rounding of the float evaluation in RasterizeRow.
+template<RenderMode render_mode, uint32_t depth_mode>
+static bool HizOccluded(TileContext* tile, const PlaneStepper3& Z, float halfpixel, int x0, int x1, int y0, int y1)
+{
+    constexpr uint32_t isp_mode = IspDepthMode(render_mode, depth_mode);
+
+    if (render_mode != RM_OPAQUE && render_mode != RM_PUNCHTHROUGH_PASS0 && render_mode != RM_PUNCHTHROUGH_PASSN)
+        return false;
+
+    if (isp_mode != 4 && isp_mode != 6)
+        return false;
+
+    // Recorded coverage is replayed by later passes, so it can't depend on the depth of this one
+    if (tile->coverageRecording || !IsDepthPlaneSafe(Z))
+        return false;
+
+    if (!tile->hizValid)
+        RebuildHiz(tile);
+
+    for (int by = y0 / RASTER_BLOCK; by <= y1 / RASTER_BLOCK; by++) {
+        double ya = halfpixel + std::max(y0, by * RASTER_BLOCK);
+        double yb = halfpixel + std::min(y1, by * RASTER_BLOCK + RASTER_BLOCK - 1);
+        double rowMax = std::max(ya * Z.ddy, yb * Z.ddy);
+        double rowMag = std::max(fabs(ya * Z.ddy), fabs(yb * Z.ddy));
+
+        for (int bx = x0 / RASTER_BLOCK; bx <= x1 / RASTER_BLOCK; bx++) {
+            double xa = halfpixel + std::max(x0, bx * RASTER_BLOCK);
+            double xb = halfpixel + std::min(x1, bx * RASTER_BLOCK + RASTER_BLOCK - 1);
+            double colMax = std::max(xa * Z.ddx, xb * Z.ddx);
+            double colMag = std::max(fabs(xa * Z.ddx), fabs(xb * Z.ddx));
+
+            double maxW = colMax + rowMax + Z.c + (colMag + rowMag + fabs(Z.c)) * 0x1p-20;
+            double zmin = tile->hizMin[by][bx];
+
+            if (isp_mode == 6 ? !(maxW < zmin) : !(maxW <= zmin))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// ISP for the pixels [x0, x1] of row y, which are all covered unless testEdges is set.
+// Only the first edgeCount edges are tested, the others are known to cover the row.
+// The vector path runs 8 pixels at a time with the same float operations as the scalar
+// one, so coverage and depth match it bit for bit. Modes with multi buffer peeling logic
+// only get their coverage and depth vectorized and flush the covered pixels one by one.
+template<RenderMode render_mode, uint32_t depth_mode, bool ZWriteDis, int edgeCount>
+static void RasterizeRow(TileContext* tile, parameter_tag_t tag, const HalfEdge* edges, bool testEdges, const PlaneStepper3& Z, float halfpixel, int y, int x0, int x1)
+{
+    float y_ps = halfpixel + y;
+
+    // Depth writes that can lower the buffer, or store NaN, invalidate the hierarchical Z
+    if (!HizPreserved(render_mode, depth_mode, ZWriteDis) || (IspWritesDepth(render_mode, ZWriteDis) && !IsDepthPlaneSafe(Z)))
+        tile->hizValid = false;
+
+#if defined(REFSW_SIMD)
+    const i32x8 lane = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    float rowXhs[4];
+    if (testEdges) {
+        for (int i = 0; i < edgeCount; i++)
+            rowXhs[i] = edges[i].C + edges[i].DX * y_ps;
+    }
+
+    float rowZ = y_ps * Z.ddy;
+
+    for (int gx = x0 & ~7; gx <= x1; gx += 8)
+    {
+        i32x8 xi = lane + gx;
+        f32x8 x_ps = __builtin_convertvector(xi, f32x8) + halfpixel;
+
+        i32x8 cover = (xi >= x0) & (xi <= x1);
+        if (testEdges) {
+            for (int i = 0; i < edgeCount; i++) {
+                f32x8 Xhs = rowXhs[i] - edges[i].DY * x_ps;
+                cover &= edges[i].T ? (Xhs > 0) | (Xhs == 0) : (Xhs > 0);
+            }
+        }
+
+        if (!LaneBits(cover))
+            continue;
+
+        if (tile->coverageRecording) {
+            tile->primitiveRows[y] |= LaneBits(cover) << gx;
+            tile->primitiveZ = Z;
+        }
+
+        f32x8 invW = x_ps * Z.ddx + rowZ + Z.c;
+        uint32_t index = y * 32 + gx;
+
+        if constexpr (render_mode == RM_OPAQUE || render_mode == RM_TRANSLUCENT_PRESORT ||
+                      render_mode == RM_PUNCHTHROUGH_PASS0 || render_mode == RM_MODIFIER) {
+            auto zb = tile->depthBuffer[depthBufferA] + index;
+
+            uint32_t mode = depth_mode;
+            if (render_mode == RM_PUNCHTHROUGH_PASS0 || render_mode == RM_MODIFIER)
+                mode = 6;
+
+            f32x8 depth;
+            memcpy(&depth, zb, sizeof(depth));
+
+            i32x8 pass = DepthPass(mode, invW, depth) & cover;
+            if (!LaneBits(pass))
+                continue;
+
+            if (render_mode == RM_MODIFIER) {
+                // Flip on Z pass, and mark valid for summary
+                tile->stencil.Flip(y, LaneBits(pass) << gx);
+            } else {
+                auto pb = tile->tagBuffer[tagBufferA] + index;
+
+                if (render_mode == RM_PUNCHTHROUGH_PASS0 || !ZWriteDis) {
+                    depth = Select(pass, invW, depth);
+                    memcpy(zb, &depth, sizeof(depth));
+                }
+
+                u32x8 tags;
+                memcpy(&tags, pb, sizeof(tags));
+                tags = Select(pass, u32x8{} + tag, tags);
+                memcpy(pb, &tags, sizeof(tags));
+
+                tile->tagStatus.valid[y] |= LaneBits(pass) << gx;
+            }
+        } else {
+            for (uint32_t bits = LaneBits(cover); bits; bits &= bits - 1) {
+                int i = __builtin_ctz(bits);
+                PixelFlush_isp<render_mode>(tile, depth_mode, ZWriteDis, x_ps[i], y_ps, invW[i], index + i, tag);
+            }
+        }
+    }
+#else
+    for (int x = x0; x <= x1; x++)
+    {
+        float x_ps = halfpixel + x;
+        bool inTriangle = true;
+        for (int i = 0; testEdges && i < edgeCount; i++)
+            inTriangle = inTriangle && edges[i].Inside(x_ps, y_ps);
+        if (!inTriangle)
+            continue;
+
+        if (tile->coverageRecording) {
+            tile->primitiveRows[y] |= 1u << x;
+            tile->primitiveZ = Z;
+        }
+
+        uint32_t index = y * 32 + x;
+        float invW = Z.Ip(x_ps, y_ps);
+        PixelFlush_isp<render_mode>(tile, depth_mode, ZWriteDis, x_ps, y_ps, invW, index, tag);
+    }
+#endif
+}
+
+// Floor of a / b for b > 0
+inline always_inline int64_t FloorDiv(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Fixed point rasterization of a triangle or quad, used when TileContext::fixedPointRaster is set.
+// Vertices are snapped to RASTER_SUBPIXEL_BITS relative to the tile and the edge equations are
+// evaluated exactly with integers, stepping from row to row. Samples exactly on an edge follow the
+// top-left rule, so a pixel on an edge shared by two primitives is drawn by exactly one of them.
+// Depth is still interpolated in float.
+// Returns false if the vertices are too far from the tile, for the float path to handle them.
+// The rows that were rasterized are returned in rows.
+template<RenderMode render_mode, uint32_t depth_mode, bool ZWriteDis, bool quad>
+static bool RasterizeTriangleFixed(TileContext* tile, parameter_tag_t tag, const float* X, const float* Y, const PlaneStepper3& Z, float halfpixel, taRECT* area, uint32_t* rows)
+{
+    constexpr int vertices = quad ? 4 : 3;
+    constexpr int64_t one = 1 << RASTER_SUBPIXEL_BITS;
+    constexpr double range = 1 << 20;
+
+    *rows = 0;
+
+    int64_t x[4], y[4];
+    for (int i = 0; i < vertices; i++) {
+        double rx = (double)X[i] - area->left;
+        double ry = (double)Y[i] - area->top;
+        if (!(fabs(rx) < range && fabs(ry) < range))
+            return false;
+
+        x[i] = (int64_t)floor(rx * one + 0.5);
+        y[i] = (int64_t)floor(ry * one + 0.5);
+    }
+
+    // Winding from the first three vertices, like the float path
+    int64_t tri_area = (x[0] - x[2]) * (y[1] - y[2]) - (y[0] - y[2]) * (x[1] - x[2]);
+    if (tri_area == 0)
+        return true;
+
+    int64_t sgn = tri_area > 0 ? -1 : 1;
+
+    // Sample position of pixel (0, 0)
+    int64_t sample = halfpixel != 0 ? one / 2 : 0;
+
+    struct {
+        int64_t E;      // edge function at the first pixel of the current row
+        int64_t stepX;  // change per pixel to the right
+        int64_t stepY;  // change per row
+        int64_t bias;   // 0 if samples on the edge are inside, 1 otherwise
+    } edges[4];
+
+    int miny = 0, maxy = 31;
+    if (!quad) {
+        int64_t top = std::min({ y[0], y[1], y[2] }), bottom = std::max({ y[0], y[1], y[2] });
+        miny = (int)std::max<int64_t>(miny, -FloorDiv(sample - top, one));
+        maxy = (int)std::min<int64_t>(maxy, FloorDiv(bottom - sample, one));
+    }
+
+    for (int i = 0; i < vertices; i++) {
+        int n = (i + 1) % vertices;
+        int64_t DX = sgn * (x[i] - x[n]);
+        int64_t DY = sgn * (y[i] - y[n]);
+
+        // top-left: the edge function grows to the right, or is horizontal and grows downwards
+        bool topLeft = -DY > 0 || (DY == 0 && DX > 0);
+
+        edges[i].E = DY * (x[i] - sample) - DX * (y[i] - (sample + miny * one));
+        edges[i].stepX = -DY * one;
+        edges[i].stepY = DX * one;
+        edges[i].bias = topLeft ? 0 : 1;
+    }
+
+    for (int py = miny; py <= maxy; py++)
+    {
+        // pixels with E + stepX * px >= bias, for every edge
+        int64_t x0 = 0, x1 = 31;
+        for (int i = 0; i < vertices; i++) {
+            auto& e = edges[i];
+            int64_t need = e.bias - e.E;
+
+            if (e.stepX > 0)
+                x0 = std::max(x0, -FloorDiv(-need, e.stepX));
+            else if (e.stepX < 0)
+                x1 = std::min(x1, FloorDiv(-need, -e.stepX));
+            else if (need > 0)
+                x1 = -1;
+
+            e.E += e.stepY;
+        }
+
+        if (x0 <= x1) {
+            RasterizeRow<render_mode, depth_mode, ZWriteDis, 0>(tile, tag, nullptr, false, Z, halfpixel, py, (int)x0, (int)x1);
+            *rows |= 1u << py;
+        }
+    }
+
+    return true;
+}
 
 #define FLUSH_NAN(a) std::isnan(a) ? 0 : a
 
-    const float Y1 = FLUSH_NAN(v1.y);
-    const float Y2 = FLUSH_NAN(v2.y);
-    const float Y3 = FLUSH_NAN(v3.y);
-    const float Y4 = v4 ? FLUSH_NAN(v4->y) : 0;
+// Read the screen coordinates of a triangle or quad and apply the ISP cull mode
+// Returns false if the primitive is culled
+template<bool pp_Quad>
+static bool CullTriangle(DrawParameters* params, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, float* X, float* Y, int* sgn)
+{
+    const float Y1 = Y[0] = FLUSH_NAN(v1.y);
+    const float Y2 = Y[1] = FLUSH_NAN(v2.y);
+    const float Y3 = Y[2] = FLUSH_NAN(v3.y);
+    Y[3] = pp_Quad ? FLUSH_NAN(v4->y) : 0;
 
-    const float X1 = FLUSH_NAN(v1.x);
-    const float X2 = FLUSH_NAN(v2.x);
-    const float X3 = FLUSH_NAN(v3.x);
-    const float X4 = v4 ? FLUSH_NAN(v4->x) : 0;
+    const float X1 = X[0] = FLUSH_NAN(v1.x);
+    const float X2 = X[1] = FLUSH_NAN(v2.x);
+    const float X3 = X[2] = FLUSH_NAN(v3.x);
+    X[3] = pp_Quad ? FLUSH_NAN(v4->x) : 0;
 
-    int sgn = 1;
+    *sgn = 1;
 
     float tri_area = ((X1 - X3) * (Y2 - Y3) - (Y1 - Y3) * (X2 - X3));
 
     if (tri_area > 0)
-        sgn = -1;
+        *sgn = -1;
 
     // cull
     if (params->isp.CullMode != 0) {
@@ -574,7 +1228,7 @@ void RasterizeTriangle(DrawParameters* params, parameter_tag_t tag, const Vertex
         float abs_area = fabsf(tri_area);
 
         if (abs_area < FPU_CULL_VAL)
-            return;
+            return false;
 
         if (params->isp.CullMode >= 2) {
             uint32_t mode = params->isp.CullMode & 1;
@@ -583,110 +1237,393 @@ void RasterizeTriangle(DrawParameters* params, parameter_tag_t tag, const Vertex
                 (mode == 0 && tri_area < 0) ||
                 (mode == 1 && tri_area > 0)) {
                 RENDLOG("CULLED");
-                return;
+                return false;
             }
         }
     }
 
-    // Bounding rectangle
-//  int minx = mmin(X1, X2, X3, area->left);
-//  int miny = mmin(Y1, Y2, Y3, area->top);
+    return true;
+}
+
+// Edge equations and coverage bounds of a triangle or quad for the float rasterizer
+struct RasterSetup
+{
+    HalfEdge edges[4];
+    PlaneStepper3 Z;
+
+    bool clip;                      // bounds and row spans are exact, see SetupEdges
+    int minx, maxx, miny, maxy;     // bounding rectangle, clipped to the tile
+    uint32_t rows;                  // rows that survive the row cull
+};
 
-//  int spanx = mmax(X1+1, X2+1, X3+1, area->right - 1) - minx + 1;
-//  int spany = mmax(Y1+1, Y2+1, Y3+1, area->bottom - 1) - miny + 1;
+// Set up the half-edge equations, bounding rectangle and row cull of a triangle or quad
+// Returns false if it misses the tile
+template<bool pp_Quad>
+static bool SetupEdges(RasterSetup* setup, const float* X, const float* Y, int sgn, float halfpixel, taRECT* area)
+{
+    constexpr int edgeCount = pp_Quad ? 4 : 3;
 
-    //Inside scissor area?
-//  if (spanx < 0 || spany < 0)
-//      return;
+    const float X1 = X[0], X2 = X[1], X3 = X[2], X4 = X[3];
+    const float Y1 = Y[0], Y2 = Y[1], Y3 = Y[2], Y4 = Y[3];
 
     // Half-edge constants
     const float DX12 = sgn * (X1 - X2);
     const float DX23 = sgn * (X2 - X3);
-    const float DX31 = v4 ? sgn * (X3 - X4) : sgn * (X3 - X1);
-    const float DX41 = v4 ? sgn * (X4 - X1) : 0;
+    const float DX31 = pp_Quad ? sgn * (X3 - X4) : sgn * (X3 - X1);
+    const float DX41 = pp_Quad ? sgn * (X4 - X1) : 0;
 
     const float DY12 = sgn * (Y1 - Y2);
     const float DY23 = sgn * (Y2 - Y3);
-    const float DY31 = v4 ? sgn * (Y3 - Y4) : sgn * (Y3 - Y1);
-    const float DY41 = v4 ? sgn * (Y4 - Y1) : 0;
+    const float DY31 = pp_Quad ? sgn * (Y3 - Y4) : sgn * (Y3 - Y1);
+    const float DY41 = pp_Quad ? sgn * (Y4 - Y1) : 0;
 
     float C1 = DY12 * (X1 - area->left) - DX12 * (Y1 - area->top);
     float C2 = DY23 * (X2 - area->left) - DX23 * (Y2 - area->top);
     float C3 = DY31 * (X3 - area->left) - DX31 * (Y3 - area->top);
-    float C4 = v4 ? DY41 * (X4 - area->left) - DX41 * (Y4 - area->top) : 1;
+    float C4 = pp_Quad ? DY41 * (X4 - area->left) - DX41 * (Y4 - area->top) : 1;
 
     bool T1 = IsTopLeft(X2 - X1, Y2 - Y1);
     bool T2 = IsTopLeft(X3 - X2, Y3 - Y2);
     bool T3, T4;
-    if (!v4) {
+    if (!pp_Quad) {
         T3 = IsTopLeft(X1 - X3, Y1 - Y3);
         T4 = true;
     } else {
         T3 = IsTopLeft(X4 - X3, Y4 - Y3);
         T4 = IsTopLeft(X1 - X4, Y1 - Y4);
     }
-    PlaneStepper3 Z;
-    Z.Setup(area, v1, v2, v3, v1.z, v2.z, v3.z);
 
+    auto& edges = setup->edges;
+    edges[0] = { C1, DX12, DY12, T1 };
+    edges[1] = { C2, DX23, DY23, T2 };
+    edges[2] = { C3, DX31, DY31, T3 };
+    edges[3] = { C4, DX41, DY41, T4 };
+
+    // Bounding rectangle, clipped to the tile.
+    // Each edge function is monotonic along a row or a column, so the pixels inside one edge form a
+    // contiguous run and the edge reaches furthest into the tile on one of its borders. The rectangle
+    // is narrowed with the same edge evaluations as the per pixel test, so it can't drop a pixel the
+    // test would accept. Coordinates big enough to overflow the edge functions scan the whole tile.
+    int minx = 0, maxx = 31;
+    int miny = 0, maxy = 31;
+
+    const bool clip = IsClippable(X1) && IsClippable(X2) && IsClippable(X3) && IsClippable(X4) &&
+                      IsClippable(Y1) && IsClippable(Y2) && IsClippable(Y3) && IsClippable(Y4);
+
+    if (clip) {
+        for (int i = 0; i < edgeCount; i++) {
+            auto& e = edges[i];
+            float y_ps = halfpixel + (e.DX > 0 ? 31 : 0);
+            if (!NarrowToInside(EdgeDir(e.DY), minx, maxx, [&](int x) { return e.Inside(halfpixel + x, y_ps); }))
+                return false;
+        }
+
+        for (int i = 0; i < edgeCount; i++) {
+            auto& e = edges[i];
+            float x_ps = halfpixel + (e.DY > 0 ? minx : maxx);
+            if (!NarrowToInside(-EdgeDir(e.DX), miny, maxy, [&](int y) { return e.Inside(x_ps, halfpixel + y); }))
+                return false;
+        }
+    }
+
+    // Rows that survive the row cull
+    uint32_t rows = 0;
+    for (int y = miny; y <= maxy; y++)
+    {
+        float y_ps = halfpixel + y;
+            float kXhs12 = C1 + DX12 * y_ps - DY12 * 0;
+            float kXhs23 = C2 + DX23 * y_ps - DY23 * 0;
+            float kXhs31 = C3 + DX31 * y_ps - DY31 * 0;
+            float kXhs41 = C4 + DX41 * y_ps - DY41 * 0;
+            float zXhs12 = C1 + DX12 * y_ps - DY12 * 32.5f;
+            float zXhs23 = C2 + DX23 * y_ps - DY23 * 32.5f;
+            float zXhs31 = C3 + DX31 * y_ps - DY31 * 32.5f;
+            float zXhs41 = C4 + DX41 * y_ps - DY41 * 32.5f;
+
+	if ((kXhs12 < 0 && zXhs12 < 0) || (kXhs23 < 0 && zXhs23 < 0) || (kXhs31 < 0 && zXhs31 < 0) || (pp_Quad && kXhs41 < 0 && kXhs41 < 0))
+	{
+		continue;
+	}
+        rows |= 1u << y;
+    }
+
+    setup->clip = clip;
+    setup->minx = minx;
+    setup->maxx = maxx;
+    setup->miny = miny;
+    setup->maxy = maxy;
+    setup->rows = rows;
+
+    return true;
+}
+
+// ISP for one row of a set up primitive, narrowed to the span inside all edges
+template<RenderMode render_mode, uint32_t depth_mode, bool ZWriteDis, int edgeCount>
+static void RasterizeSpan(TileContext* tile, parameter_tag_t tag, const RasterSetup& setup, float halfpixel, int y)
+{
+    float y_ps = halfpixel + y;
+
+    // Span of the row inside all edges, exact when clipping
+    int spanx0 = setup.minx, spanx1 = setup.maxx;
+    if (setup.clip) {
+        for (int i = 0; i < edgeCount; i++) {
+            auto& e = setup.edges[i];
+            if (!NarrowToInside(EdgeDir(e.DY), spanx0, spanx1, [&](int x) { return e.Inside(halfpixel + x, y_ps); }))
+                return;
+        }
+    }
+
+    RasterizeRow<render_mode, depth_mode, ZWriteDis, edgeCount>(tile, tag, setup.edges, !setup.clip, setup.Z, halfpixel, y, spanx0, spanx1);
+}
+
+// Rasterize a single triangle to ISP (or ISP+TSP for PT)
+// Specialized on the render mode, ISP depth mode and z write disable, and on whether v4 is set
+// Returns the rows it rasterized, which hold every pixel whose tag it wrote
+template<uint32_t pp_RenderMode, uint32_t pp_DepthMode, bool pp_ZWriteDis, bool pp_Quad>
+uint32_t RasterizeTriangle(TileContext* tile, DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area)
+{
+    constexpr auto render_mode = (RenderMode)pp_RenderMode;
+    constexpr int edgeCount = pp_Quad ? 4 : 3;
+
+    float X[4], Y[4];
+    int sgn;
+    if (!CullTriangle<pp_Quad>(params, v1, v2, v3, v4, X, Y, &sgn))
+        return 0;
+
+    RasterSetup setup;
+    auto& Z = setup.Z;
+    Z.Setup(area, v1, v2, v3, v1.z, v2.z, v3.z);
+
+    float halfpixel = HALF_OFFSET.fpu_pixel_half_offset ? 0.5f : 0;
+
+    if (tile->fixedPointRaster) {
+        uint32_t rows;
+        if (RasterizeTriangleFixed<render_mode, pp_DepthMode, pp_ZWriteDis, pp_Quad>(tile, tag, X, Y, Z, halfpixel, area, &rows)) {
+            if (render_mode != RM_MODIFIER && rows != 0)
+                AddTileTriangle(tile, tag, Z);
+            return rows;
+        }
+    }
+
+    if (!SetupEdges<pp_Quad>(&setup, X, Y, sgn, halfpixel, area))
+        return 0;
+
+    if (HizOccluded<render_mode, pp_DepthMode>(tile, Z, halfpixel, setup.minx, setup.maxx, setup.miny, setup.maxy))
+        return 0;
+
+    if (render_mode != RM_MODIFIER && setup.rows != 0)
+        AddTileTriangle(tile, tag, Z);
+
+    const auto& edges = setup.edges;
+    const bool clip = setup.clip;
+    const int minx = setup.minx, maxx = setup.maxx;
+    const int miny = setup.miny, maxy = setup.maxy;
+    const uint32_t rows = setup.rows;
+
+    if (pp_Quad && clip && IsAxisAligned(edges)) {
+        // Screen aligned quads, mostly sprites. Every edge depends only on the row or only on the
+        // column, so the bounding rectangle is the exact coverage and rows are filled without edge tests.
+        for (int y = miny; y <= maxy; y++)
+        {
+            if (rows & (1u << y))
+                RasterizeRow<render_mode, pp_DepthMode, pp_ZWriteDis, 0>(tile, tag, nullptr, false, Z, halfpixel, y, minx, maxx);
+        }
+        return rows;
+    }
+
+    if (clip && maxx - minx >= RASTER_BLOCK - 1 && maxy - miny >= RASTER_BLOCK - 1) {
+        // Hierarchical traversal for large primitives. An edge is largest at one corner of a block and
+        // smallest at the opposite one, so two tests per edge tell whether the block is outside,
+        // inside or crossed by it. Blocks inside all edges skip the per pixel test.
+        for (int by = miny & ~(RASTER_BLOCK - 1); by <= maxy; by += RASTER_BLOCK)
+        {
+            int y0 = std::max(by, miny), y1 = std::min(by + RASTER_BLOCK - 1, maxy);
+            uint32_t blockRows = rows & (uint32_t)(((1ull << (y1 + 1)) - 1) & ~((1ull << y0) - 1));
+            if (!blockRows)
+                continue;
+
+            for (int bx = minx & ~(RASTER_BLOCK - 1); bx <= maxx; bx += RASTER_BLOCK)
+            {
+                int x0 = std::max(bx, minx), x1 = std::min(bx + RASTER_BLOCK - 1, maxx);
+
+                if (HizOccluded<render_mode, pp_DepthMode>(tile, Z, halfpixel, x0, x1, y0, y1))
+                    continue;
+
+                bool outside = false, partial = false;
+                for (int i = 0; i < edgeCount; i++) {
+                    auto& e = edges[i];
+                    float inner_x = halfpixel + (e.DY > 0 ? x0 : x1);
+                    float inner_y = halfpixel + (e.DX > 0 ? y1 : y0);
+                    float outer_x = halfpixel + (e.DY > 0 ? x1 : x0);
+                    float outer_y = halfpixel + (e.DX > 0 ? y0 : y1);
+
+                    if (!e.Inside(inner_x, inner_y)) {
+                        outside = true;
+                        break;
+                    }
+                    partial |= !e.Inside(outer_x, outer_y);
+                }
+                if (outside)
+                    continue;
+
+                for (int y = y0; y <= y1; y++)
+                {
+                    if (blockRows & (1u << y))
+                        RasterizeRow<render_mode, pp_DepthMode, pp_ZWriteDis, edgeCount>(tile, tag, edges, partial, Z, halfpixel, y, x0, x1);
+                }
+            }
+        }
+        return rows;
+    }
+
+    for (int y = miny; y <= maxy; y++)
+    {
+        if (rows & (1u << y))
+            RasterizeSpan<render_mode, pp_DepthMode, pp_ZWriteDis, edgeCount>(tile, tag, setup, halfpixel, y);
+    }
+
+    return rows;
+}
+
+// Rasterize the triangles of a strip to ISP in one pass over the tile.
+// Triangles are set up as in RasterizeTriangle and each row is drawn for every triangle in
+// strip order, so every pixel sees the same ISP sequence as drawing the triangles one by one.
+// Only valid for render modes without per triangle work after rasterization.
+template<uint32_t pp_RenderMode, uint32_t pp_DepthMode, bool pp_ZWriteDis>
+void RasterizeStrip(TileContext* tile, DrawParameters* params, const StripTriangle* triangles, int count, taRECT* area)
+{
+    constexpr auto render_mode = (RenderMode)pp_RenderMode;
+
+    if (tile->fixedPointRaster) {
+        for (int i = 0; i < count; i++) {
+            auto& t = triangles[i];
+            RasterizeTriangle<pp_RenderMode, pp_DepthMode, pp_ZWriteDis, false>(tile, params, t.tag, *t.v1, *t.v2, *t.v3, nullptr, area);
+        }
+        return;
+    }
+
+    float halfpixel = HALF_OFFSET.fpu_pixel_half_offset ? 0.5f : 0;
+
+    RasterSetup setups[6];
+    parameter_tag_t tags[6];
+    int active = 0;
+    int miny = 32, maxy = -1;
+    bool hiz = true;
+
+    for (int i = 0; i < count; i++) {
+        auto& t = triangles[i];
+        auto& setup = setups[active];
+
+        float X[4], Y[4];
+        int sgn;
+        if (!CullTriangle<false>(params, *t.v1, *t.v2, *t.v3, nullptr, X, Y, &sgn))
+            continue;
+
+        setup.Z.Setup(area, *t.v1, *t.v2, *t.v3, t.v1->z, t.v2->z, t.v3->z);
+
+        if (!SetupEdges<false>(&setup, X, Y, sgn, halfpixel, area) || !setup.rows)
+            continue;
+
+        // The whole strip is set up before drawing, so a triangle that could write NaN depth
+        // stops the occlusion test for the ones after it
+        if (hiz && HizOccluded<render_mode, pp_DepthMode>(tile, setup.Z, halfpixel, setup.minx, setup.maxx, setup.miny, setup.maxy))
+            continue;
+        hiz &= IsDepthPlaneSafe(setup.Z);
+
+        if (render_mode != RM_MODIFIER)
+            AddTileTriangle(tile, t.tag, setup.Z);
+
+        miny = std::min(miny, setup.miny);
+        maxy = std::max(maxy, setup.maxy);
+        tags[active++] = t.tag;
+    }
+
+    for (int y = miny; y <= maxy; y++)
+    {
+        for (int i = 0; i < active; i++) {
+            if (setups[i].rows & (1u << y))
+                RasterizeSpan<render_mode, pp_DepthMode, pp_ZWriteDis, 3>(tile, tags[i], setups[i], halfpixel, y);
+        }
+    }
+}
+
+void BeginCoverageCache(TileContext* tile)
+{
+    tile->coverage.clear();
+    tile->coverageRows.clear();
+    tile->coverageRecording = true;
+    tile->coverageValid = true;
+}
+
+void EndCoverageCache(TileContext* tile)
+{
+    tile->coverageRecording = false;
+}
+
+void BeginPrimitiveCoverage(TileContext* tile)
+{
+    memset(tile->primitiveRows, 0, sizeof(tile->primitiveRows));
+}
+
+// RasterizeRow records the covered pixels and the depth plane of the primitive
+void EndPrimitiveCoverage(TileContext* tile, parameter_tag_t tag)
+{
+    int miny = 0, maxy = 31;
+    while (miny <= maxy && !tile->primitiveRows[miny])
+        miny++;
+    while (maxy >= miny && !tile->primitiveRows[maxy])
+        maxy--;
+
+    if (miny > maxy)
+        return;
+
+    if (tile->coverageRows.size() + (maxy - miny + 1) > MAX_COVERAGE_ROWS) {
+        tile->coverageRecording = false;
+        tile->coverageValid = false;
+        return;
+    }
+
+    tile->coverage.push_back({ tag, tile->primitiveZ, (uint8_t)miny, (uint8_t)maxy, (uint32_t)tile->coverageRows.size() });
+    tile->coverageRows.insert(tile->coverageRows.end(), tile->primitiveRows + miny, tile->primitiveRows + maxy + 1);
+}
+
+// Replay the recorded primitives in list order. Every covered run of a row goes through the same
+// RasterizeRow as when it was recorded, so the depth and tag updates match walking the list again
+template<RenderMode render_mode>
+void RenderCoverageCache(TileContext* tile)
+{
     float halfpixel = HALF_OFFSET.fpu_pixel_half_offset ? 0.5f : 0;
-    float y_ps    = halfpixel;
-    float minx_ps = halfpixel;
 
-    // Loop through ALL pixels in the tile (no smart clipping)
-	for (int y = 0; y < 32; y++)
-    {
-        float x_ps = minx_ps;
-            float kXhs12 = C1 + DX12 * y_ps - DY12 * 0;
-            float kXhs23 = C2 + DX23 * y_ps - DY23 * 0;
-            float kXhs31 = C3 + DX31 * y_ps - DY31 * 0;
-            float kXhs41 = C4 + DX41 * y_ps - DY41 * 0;
-            float zXhs12 = C1 + DX12 * y_ps - DY12 * 32.5f;
-            float zXhs23 = C2 + DX23 * y_ps - DY23 * 32.5f;
-            float zXhs31 = C3 + DX31 * y_ps - DY31 * 32.5f;
-            float zXhs41 = C4 + DX41 * y_ps - DY41 * 32.5f;
+    for (const auto& prim : tile->coverage) {
+        const uint32_t* rows = &tile->coverageRows[prim.firstRow];
 
-	if ((kXhs12 < 0 && zXhs12 < 0) || (kXhs23 < 0 && zXhs23 < 0) || (kXhs31 < 0 && zXhs31 < 0) || (kXhs41 < 0 && kXhs41 < 0))
-	{
-		goto next_y;
-	}
+        if (HizOccluded<render_mode, 0>(tile, prim.Z, halfpixel, 0, 31, prim.miny, prim.maxy))
+            continue;
 
-        for (int x = 0; x < 32; x++)
-        {
-            float Xhs12 = C1 + DX12 * y_ps - DY12 * x_ps;
-            float Xhs23 = C2 + DX23 * y_ps - DY23 * x_ps;
-            float Xhs31 = C3 + DX31 * y_ps - DY31 * x_ps;
-            float Xhs41 = C4 + DX41 * y_ps - DY41 * x_ps;
-
-            bool inTriangle = (Xhs12 > 0 || (T1 && Xhs12 == 0)) &&
-                              (Xhs23 > 0 || (T2 && Xhs23 == 0)) &&
-                              (Xhs31 > 0 || (T3 && Xhs31 == 0)) &&
-                              (Xhs41 > 0 || (T4 && Xhs41 == 0));
-			
-            if (inTriangle) {
-                uint32_t index = y * 32 + x;
-                float invW = Z.Ip(x_ps, y_ps);
-                PixelFlush_isp<render_mode>(params->isp.DepthMode, params->isp.ZWriteDis, x_ps, y_ps, invW, index, tag);
-            }
+        for (int y = prim.miny; y <= prim.maxy; y++) {
+            uint32_t bits = rows[y - prim.miny];
+
+            for (int x = 0; x < 32;) {
+                if (!(bits & (1u << x))) {
+                    x++;
+                    continue;
+                }
 
-            x_ps = x_ps + 1;
+                int x0 = x;
+                while (x < 32 && (bits & (1u << x)))
+                    x++;
+
+                RasterizeRow<render_mode, 0, false, 0>(tile, prim.tag, nullptr, false, prim.Z, halfpixel, y, x0, x - 1);
+            }
         }
-    next_y:
-        y_ps = y_ps + 1;
     }
 }
 
-void (*RasterizeTriangle_table[7])(DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area) = {
-    &RasterizeTriangle<RM_OPAQUE>,
-    &RasterizeTriangle<RM_PUNCHTHROUGH_PASS0>,
-    &RasterizeTriangle<RM_PUNCHTHROUGH_PASSN>,
-    &RasterizeTriangle<RM_PUNCHTHROUGH_MV>,
-    &RasterizeTriangle<RM_TRANSLUCENT_AUTOSORT>,
-    &RasterizeTriangle<RM_TRANSLUCENT_PRESORT>,
-    &RasterizeTriangle<RM_MODIFIER>
-};
+template void RenderCoverageCache<RM_PUNCHTHROUGH_PASSN>(TileContext* tile);
+template void RenderCoverageCache<RM_TRANSLUCENT_AUTOSORT>(TileContext* tile);
 
-uint8_t* GetColorOutputBuffer() {
-    return (uint8_t*)colorBuffer1;
+uint8_t* GetColorOutputBuffer(TileContext* tile) {
+    return (uint8_t*)tile->colorBuffer1;
 }
 
 
@@ -986,7 +1923,6 @@ static Color TextureFetch(TSP tsp, TCW tcw, int u, int v, uint32_t MipLevel) {
 uint32_t to_u8_256(uint8_t v) {
     return v + (v >> 7);
 }
-using TextureFetch_fp = decltype(&TextureFetch<false, false, false, false, 0>);
 
 // Fetch pixels from UVs, interpolate
 template<bool pp_IgnoreTexA,  bool pp_ClampU, bool pp_ClampV, bool pp_FlipU, bool pp_FlipV, uint32_t pp_FilterMode>
@@ -1214,7 +2150,7 @@ inline always_inline Color BlendCoefs(Color src, Color dst) {
 
 // Blending Unit implementation. Alpha blend, accum buffers and such
 template<uint32_t pp_SrcSel, uint32_t pp_DstSel, uint32_t pp_SrcInst, uint32_t pp_DstInst, bool pp_AlphaTest>
-static bool BlendingUnit(uint32_t index, Color col)
+static bool BlendingUnit(TileContext* tile, uint32_t index, Color col)
 {
     bool at = true;
 
@@ -1228,8 +2164,8 @@ static bool BlendingUnit(uint32_t index, Color col)
     }
 
     Color rv;
-    Color src = {.raw  = pp_SrcSel ? colorBuffer2[index] : col.raw };
-    Color dst = {.raw = pp_DstSel ? colorBuffer2[index] : colorBuffer1[index] };
+    Color src = {.raw  = pp_SrcSel ? tile->colorBuffer2[index] : col.raw };
+    Color dst = {.raw = pp_DstSel ? tile->colorBuffer2[index] : tile->colorBuffer1[index] };
         
     Color src_blend = BlendCoefs<pp_SrcInst, false>(src, dst);
     Color dst_blend = BlendCoefs<pp_DstInst, true>(src, dst);
@@ -1240,7 +2176,7 @@ static bool BlendingUnit(uint32_t index, Color col)
     }
     
     
-    (pp_DstSel ? colorBuffer2[index] : colorBuffer1[index]) = rv.raw;
+    (pp_DstSel ? tile->colorBuffer2[index] : tile->colorBuffer1[index]) = rv.raw;
     
     RENDLOG("BU: %08X %08X %08X %08X %08X %d", rv.raw, src_blend.raw, dst_blend.raw, src.raw, dst.raw, at);
 
@@ -1373,26 +2309,54 @@ void DumpTexture(TSP tsp, TCW tcw, TextureFetch_fp fetch) {
         delete[] tex;
     }
 }
+// Sample the texture of a volume at the interpolated u, v of a pixel, picking the mip level from the uv gradients
+inline always_inline Color SampleTexture(const FpuEntry *entry, uint32_t two_voume_index, float u, float v, float W)
+{
+    const auto& pipeline = entry->pipeline[two_voume_index];
+    float dTrilinear;
+    uint32_t MipLevel;
+
+    if (entry->params.tcw[two_voume_index].MipMapped) {
+        int sizeU = 8 << entry->params.tsp[two_voume_index].TexU;
+        // faux mip map cals
+        // these really don't follow hw
+        float ddx = (entry->ips.U[two_voume_index].ddx + entry->ips.V[two_voume_index].ddx);
+        float ddy = (entry->ips.U[two_voume_index].ddy + entry->ips.V[two_voume_index].ddy);
+
+        float dMip = fminf(fabsf(ddx), fabsf(ddy)) * W * sizeU * entry->params.tsp[two_voume_index].MipMapD / 4.0f;
+
+        MipLevel = 0; // biggest
+        while(dMip > 1.5 && MipLevel < 11) {
+            MipLevel ++;
+            dMip = dMip / 2;
+        }
+        dTrilinear = dMip;
+    } else {
+        dTrilinear = 0;
+        MipLevel = 0;
+    }
+
+    return pipeline.filter(entry->params.tsp[two_voume_index], entry->params.tcw[two_voume_index], u, v, MipLevel, dTrilinear, pipeline.fetch);
+}
+
 const char* dump_textures = nullptr;
 std::set<uint64_t> texture_dumps;
-using BlendingUnit_fp = decltype(&BlendingUnit<0,0,0,0,0>);
-using ColorCombiner_fp = decltype(&ColorCombiner<0,0,0>);
-using TextureFilter_fp = decltype(&TextureFilter<0,0,0,0,0,0>);
 // Implement the full texture/shade pipeline for a pixel
 
-static Color offs = { 0x20004080 }; // this one persists across invocations, as tested via bump maps. Default value was randomly chosen.
 template<bool pp_UseAlpha, bool pp_Texture, bool pp_Offset, bool pp_ColorClamp, uint32_t pp_FogCtrl, bool pp_CheapShadows>
-static bool PixelFlush_tsp(const FpuEntry *entry, float x, float y, float W, bool InVolume, uint32_t index, TextureFetch_fp fetch, TextureFilter_fp filter, ColorCombiner_fp combiner, BlendingUnit_fp blending)
+static bool PixelFlush_tsp(TileContext* tile, const FpuEntry *entry, float x, float y, float W, bool InVolume, uint32_t index, BlendingUnit_fp blending)
 {
     uint32_t two_voume_index = InVolume & !pp_CheapShadows;
-    auto cb = (Color*)colorBuffer1 + index;
+    const auto& pipeline = entry->pipeline[two_voume_index];
+    auto fetch = pipeline.fetch;
+    auto combiner = pipeline.combiner;
+    auto cb = (Color*)tile->colorBuffer1 + index;
+    auto& offs = tile->offs;
   
     Color base = { 0 }, textel = { 0 };
 
     base = InterpolateBase<pp_UseAlpha, pp_CheapShadows>(entry->ips.Col[two_voume_index], x, y, W, InVolume);
 
-    float dTrilinear;
-    uint32_t MipLevel;
     if (pp_Texture) {
         if (dump_textures) {
 
@@ -1407,29 +2371,10 @@ static bool PixelFlush_tsp(const FpuEntry *entry, float x, float y, float W, boo
         float u = entry->ips.U[two_voume_index].Ip(x, y, W);
         float v = entry->ips.V[two_voume_index].Ip(x, y, W);
 
-        if (entry->params.tcw[two_voume_index].MipMapped) {
-            int sizeU = 8 << entry->params.tsp[two_voume_index].TexU;
-            // faux mip map cals
-            // these really don't follow hw
-            float ddx = (entry->ips.U[two_voume_index].ddx + entry->ips.V[two_voume_index].ddx);
-            float ddy = (entry->ips.U[two_voume_index].ddy + entry->ips.V[two_voume_index].ddy);
-
-            float dMip = fminf(fabsf(ddx), fabsf(ddy)) * W * sizeU * entry->params.tsp[two_voume_index].MipMapD / 4.0f;
-
-            MipLevel = 0; // biggest
-            while(dMip > 1.5 && MipLevel < 11) {
-                MipLevel ++;
-                dMip = dMip / 2;
-            }
-            dTrilinear = dMip;
-        } else {
-            dTrilinear = 0;
-            MipLevel = 0;
-        }
-        
-        textel = filter(entry->params.tsp[two_voume_index], entry->params.tcw[two_voume_index], u, v, MipLevel, dTrilinear, fetch);
+        textel = SampleTexture(entry, two_voume_index, u, v, W);
         if (pp_Offset) {
             offs = InterpolateOffs<pp_CheapShadows>(entry->ips.Ofs[two_voume_index], x, y, W, InVolume);
+            tile->offsWritten = true;
         }
     }
 
@@ -1448,53 +2393,511 @@ static bool PixelFlush_tsp(const FpuEntry *entry, float x, float y, float W, boo
     //     col = { .raw = 0 };
     // }
 
-	return blending(index, col);
+	return blending(tile, index, col);
 }
-using PixelFlush_tsp_fp = decltype(&PixelFlush_tsp<0,0,0,0,0,0>);
 
-#include "gentable.h"
+#if defined(REFSW_SIMD)
+// 8 pixels of a span row, one vector per color channel. Each stage below does the same
+// integer math as its scalar template, so the vector path is bit identical to it
+struct Color8
+{
+    i32x8 bgra[4];
+};
+
+static inline always_inline Color8 UnpackColor8(const u32x8& raw) {
+    Color8 rv;
+    for (int i = 0; i < 4; i++)
+        rv.bgra[i] = (i32x8)((raw >> (i * 8)) & 255);
+    return rv;
+}
+
+static inline always_inline u32x8 PackColor8(const Color8& col) {
+    return (u32x8)(col.bgra[0] | (col.bgra[1] << 8) | (col.bgra[2] << 16) | (col.bgra[3] << 24));
+}
+
+static inline always_inline Color8 BroadcastColor8(Color col) {
+    Color8 rv;
+    for (int i = 0; i < 4; i++)
+        rv.bgra[i] = i32x8{} + col.bgra[i];
+    return rv;
+}
 
-// Lookup/create cached TSP parameters, and call PixelFlush_tsp
-bool PixelFlush_tsp(bool pp_AlphaTest, const FpuEntry* entry, float x, float y, uint32_t index, float invW, bool InVolume, ISP_BACKGND_T_type core_tag)
+static inline always_inline i32x8 to_u8_256(const i32x8& v) {
+    return v + (v >> 7);
+}
+
+static inline always_inline i32x8 Min8(const i32x8& a, const i32x8& b) {
+    return Select(a < b, a, b);
+}
+
+static inline always_inline i32x8 Max8(const i32x8& a, const i32x8& b) {
+    return Select(a > b, a, b);
+}
+
+// A plane along one row of a span, stepped 8 pixels at a time. The row term y * ddy is computed
+// once per span, and x * ddx is carried in double precision, adding 8 * ddx per step. x has a few
+// significant bits, so the products and their sums are exact in a double, and rounding them to
+// float gives the same x * ddx as PlaneStepper3::Ip. The terms are then added in the same order.
+// Infinite slopes don't step (0 * inf is NaN, and would stay NaN), they are evaluated directly
+struct PlaneRow
 {
-    uint32_t two_voume_index = InVolume & !FPU_SHAD_SCALE.intensity_shadow;
+    f64x8 xddx;
+    double step;
+    float ddx, yddy, c;
+    bool stepped;
+
+    PlaneRow() = default;
+    PlaneRow(const PlaneStepper3& p, const f32x8& x, float y) : ddx(p.ddx), yddy(y * p.ddy), c(p.c) {
+        stepped = std::isfinite(p.ddx);
+        xddx = __builtin_convertvector(x, f64x8) * (double)p.ddx;
+        step = 8.0 * p.ddx;
+    }
+
+    // The plane at x, which must be the pixels of the current step
+    f32x8 Ip(const f32x8& x) const {
+        f32x8 rv = (stepped ? __builtin_convertvector(xddx, f32x8) : x * ddx) + yddy + c;
+#if defined(REFSW_VERIFY_TSP)
+        // NaNs only have to stay NaNs, their sign depends on the operand order the compiler picks
+        f32x8 direct = x * ddx + yddy + c;
+        i32x8 same = ((i32x8)rv == (i32x8)direct) | ((rv != rv) & (direct != direct));
+        if (LaneBits(same) != 255)
+            die("Plane step missmatch");
+#endif
+        return rv;
+    }
+
+    // PlaneStepper3::IpU8 for 8 pixels
+    f32x8 IpU8(const f32x8& x, const f32x8& W) const {
+        f32x8 rv = Ip(x) * W;
+
+        rv = Select(rv < 0.0f, f32x8{}, rv);
+        rv = Select(rv > 255.0f, f32x8{} + 255.0f, rv);
+
+        return rv;
+    }
+
+    // Move to the next 8 pixels
+    void Step() {
+        xddx += step;
+    }
+};
+
+// The planes of one volume that the span pipeline reads, copied out of the FpuEntry for a row.
+// Being locals, they stay in registers across the blending stores of the span
+struct SpanPlanes
+{
+    PlaneRow invW, U, V;
+    PlaneRow Col[4], Ofs[4];
+    bool texture, offset;
+
+    SpanPlanes(const IPs3& ips, uint32_t two_voume_index, const f32x8& x, float y, bool texture, bool offset) : texture(texture), offset(offset) {
+        invW = PlaneRow(ips.invW, x, y);
+        for (int i = 0; i < 4; i++)
+            Col[i] = PlaneRow(ips.Col[two_voume_index][i], x, y);
+
+        if (texture) {
+            U = PlaneRow(ips.U[two_voume_index], x, y);
+            V = PlaneRow(ips.V[two_voume_index], x, y);
+            if (offset) {
+                for (int i = 0; i < 4; i++)
+                    Ofs[i] = PlaneRow(ips.Ofs[two_voume_index][i], x, y);
+            }
+        }
+    }
+
+    void Step() {
+        invW.Step();
+        for (int i = 0; i < 4; i++)
+            Col[i].Step();
+
+        if (texture) {
+            U.Step();
+            V.Step();
+            if (offset) {
+                for (int i = 0; i < 4; i++)
+                    Ofs[i].Step();
+            }
+        }
+    }
+};
+
+// InterpolateBase/InterpolateOffs for 8 pixels, mult is applied to the first `scaled` channels
+static inline always_inline Color8 InterpolateColor8(const PlaneRow* Col, const f32x8& x, const f32x8& W, uint32_t mult, int scaled) {
+    Color8 rv;
+    for (int i = 0; i < 4; i++) {
+        f32x8 v = Col[i].IpU8(x, W);
+        v = i < scaled ? 0.5f + v * (float)mult / 256.0f : 0.5f + v;
+        rv.bgra[i] = __builtin_convertvector(v, i32x8) & 255;
+    }
+    return rv;
+}
+
+// ColorCombiner for 8 pixels
+template<bool pp_Texture, bool pp_Offset>
+static inline always_inline Color8 ColorCombiner8(uint32_t ShadInstr, const Color8& base, const Color8& textel, const Color8& offset) {
+    Color8 rv = base;
+    if (pp_Texture)
+    {
+        switch(ShadInstr) {
+            case 0:
+                rv = textel;
+                break;
+
+            case 1:
+                for (int i = 0; i < 3; i++)
+                    rv.bgra[i] = (textel.bgra[i] * to_u8_256(base.bgra[i])) >> 8;
+                rv.bgra[3] = textel.bgra[3];
+                break;
+
+            case 2:
+                {
+                    i32x8 tb = to_u8_256(textel.bgra[3]);
+                    i32x8 cb = 256 - tb;
+                    for (int i = 0; i < 3; i++)
+                        rv.bgra[i] = (textel.bgra[i] * tb + base.bgra[i] * cb) >> 8;
+                    rv.bgra[3] = base.bgra[3];
+                }
+                break;
+
+            case 3:
+                for (int i = 0; i < 4; i++)
+                    rv.bgra[i] = (textel.bgra[i] * to_u8_256(base.bgra[i])) >> 8;
+                break;
+        }
+
+        if (pp_Offset) {
+            for (int i = 0; i < 3; i++)
+                rv.bgra[i] = Min8(rv.bgra[i] + offset.bgra[i], i32x8{} + 255);
+        }
+    }
+    return rv;
+}
+
+// FogUnit for 8 pixels. The fog table is looked up per pixel, for the lanes in `lanes`
+template<bool pp_Offset, bool pp_ColorClamp, uint32_t pp_FogCtrl>
+static inline always_inline Color8 FogUnit8(Color8 col, const f32x8& invW, const i32x8& offs_a, uint32_t lanes) {
+    if (pp_ColorClamp) {
+        Color clamp_max = { FOG_CLAMP_MAX };
+        Color clamp_min = { FOG_CLAMP_MIN };
+
+        for (int i = 0; i < 4; i++)
+        {
+            col.bgra[i] = Min8(col.bgra[i], i32x8{} + clamp_max.bgra[i]);
+            col.bgra[i] = Max8(col.bgra[i], i32x8{} + clamp_min.bgra[i]);
+        }
+    }
+
+    switch(pp_FogCtrl) {
+        // Look up mode 1
+        case 0b00:
+        // look up mode 2
+        case 0b11:
+            {
+                i32x8 fog_alpha = {};
+                for (uint32_t bits = lanes; bits; bits &= bits - 1) {
+                    int i = CountTrailingZeros(bits);
+                    fog_alpha[i] = LookupFogTable(invW[i]);
+                }
+
+                i32x8 fog_inv = 255 ^ fog_alpha;
+
+                Color col_ram = { FOG_COL_RAM };
+
+                if (pp_FogCtrl == 0b00) {
+                    for (int i = 0; i < 3; i++)
+                        col.bgra[i] = (col.bgra[i] * to_u8_256(fog_inv) + col_ram.bgra[i] * to_u8_256(fog_alpha)) >> 8;
+                } else {
+                    for (int i = 0; i < 3; i++)
+                        col.bgra[i] = i32x8{} + col_ram.bgra[i];
+                    col.bgra[3] = fog_alpha;
+                }
+            }
+            break;
+
+        // Per Vertex
+        case 0b01:
+            if (pp_Offset) {
+                Color col_vert = { FOG_COL_VERT };
+                i32x8 inv = 255 ^ offs_a;
+
+                for (int i = 0; i < 3; i++)
+                    col.bgra[i] = (col.bgra[i] * to_u8_256(inv) + col_vert.bgra[i] * to_u8_256(offs_a)) >> 8;
+            }
+            break;
+
+        // No Fog
+        case 0b10:
+            break;
+    }
+
+    return col;
+}
+
+// BlendCoefs for 8 pixels
+static inline always_inline Color8 BlendCoefs8(uint32_t AlphaInst, bool srcOther, const Color8& src, const Color8& dst) {
+    Color8 rv;
+
+    switch(AlphaInst>>1) {
+        // zero
+        case 0: rv = Color8{}; break;
+        // other color
+        case 1: rv = srcOther ? src : dst; break;
+        // src alpha
+        case 2: for (int i = 0; i < 4; i++) rv.bgra[i] = src.bgra[3]; break;
+        // dst alpha
+        case 3: for (int i = 0; i < 4; i++) rv.bgra[i] = dst.bgra[3]; break;
+    }
+
+    if (AlphaInst & 1) {
+        for (int i = 0; i < 4; i++)
+            rv.bgra[i] = 255 - rv.bgra[i];
+    }
+
+    return rv;
+}
+
+// BlendingUnit for 8 pixels, only the lanes in `lanes` are written. Returns the lanes that pass the alpha test
+static inline always_inline uint32_t BlendingUnit8(TileContext* tile, TSP tsp, bool pp_AlphaTest, uint32_t index, uint32_t lanes, Color8 col)
+{
+    i32x8 at = ~i32x8{};
+
+    if (pp_AlphaTest) {
+        at = ~((u32x8)col.bgra[3] < PT_ALPHA_REF);
+        col.bgra[3] = at & 255;
+    }
+
+    u32x8 cb1, cb2;
+    memcpy(&cb1, tile->colorBuffer1 + index, sizeof(cb1));
+    memcpy(&cb2, tile->colorBuffer2 + index, sizeof(cb2));
+
+    Color8 src = tsp.SrcSelect ? UnpackColor8(cb2) : col;
+    Color8 dst = UnpackColor8(tsp.DstSelect ? cb2 : cb1);
+
+    Color8 src_blend = BlendCoefs8(tsp.SrcInstr, false, src, dst);
+    Color8 dst_blend = BlendCoefs8(tsp.DstInstr, true, src, dst);
+
+    Color8 rv;
+    for (int j = 0; j < 4; j++)
+        rv.bgra[j] = Min8((src.bgra[j] * to_u8_256(src_blend.bgra[j]) + dst.bgra[j] * to_u8_256(dst_blend.bgra[j])) >> 8, i32x8{} + 255);
+
+    const i32x8 lane = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    i32x8 store = ((i32x8{} + (int32_t)lanes) >> lane & 1) != 0;
+
+    auto out = tsp.DstSelect ? tile->colorBuffer2 + index : tile->colorBuffer1 + index;
+    u32x8 blended = Select(store, PackColor8(rv), tsp.DstSelect ? cb2 : cb1);
+    memcpy(out, &blended, sizeof(blended));
+
+    return LaneBits(at) & lanes;
+}
+
+// The full texture/shade pipeline for the pixels [x0, x1] of row y, 8 pixels at a time.
+// Texture sampling and the fog table stay per pixel, everything else is done on vectors
+template<bool pp_UseAlpha, bool pp_Texture, bool pp_Offset, bool pp_ColorClamp, uint32_t pp_FogCtrl, bool pp_CheapShadows>
+static uint32_t PixelFlush_tspSpan(TileContext* tile, const FpuEntry *entry, float halfpixel, int y, int x0, int x1, bool InVolume, bool pp_AlphaTest)
+{
+    uint32_t two_voume_index = InVolume & !pp_CheapShadows;
+    const TSP tsp = entry->params.tsp[two_voume_index];
+    const i32x8 lane = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    // x steps by whole pixels, which is exact in float
+    int gx = x0 & ~7;
+    f32x8 x_ps = __builtin_convertvector(lane + gx, f32x8) + halfpixel;
+
+    float y_ps = y + halfpixel;
+    SpanPlanes planes(entry->ips, two_voume_index, x_ps, y_ps, pp_Texture, pp_Offset);
+
+    uint32_t mult = 256;
+    if (pp_CheapShadows) {
+        if (InVolume) {
+            mult = to_u8_256(FPU_SHAD_SCALE.scale_factor);
+        }
+    }
+
+    uint32_t span = SpanMask(x0, x1);
+    uint32_t AlphaTestPassed = 0;
+
+    Color8 offs = BroadcastColor8(tile->offs);
+
+    for (; gx <= x1; gx += 8, x_ps += 8.0f, planes.Step()) {
+        uint32_t lanes = (span >> gx) & 255;
+        f32x8 W = 1.0f / planes.invW.Ip(x_ps);
+
+        Color8 base = InterpolateColor8(planes.Col, x_ps, W, mult, 4);
+        if (!pp_UseAlpha)
+            base.bgra[3] = i32x8{} + 255;
+
+        Color8 textel = {};
+        if (pp_Texture) {
+            f32x8 u = planes.U.Ip(x_ps) * W;
+            f32x8 v = planes.V.Ip(x_ps) * W;
+
+            for (uint32_t bits = lanes; bits; bits &= bits - 1) {
+                int i = CountTrailingZeros(bits);
+                Color t = SampleTexture(entry, two_voume_index, u[i], v[i], W[i]);
+                for (int c = 0; c < 4; c++)
+                    textel.bgra[c][i] = t.bgra[c];
+            }
+
+            if (pp_Offset) {
+                offs = InterpolateColor8(planes.Ofs, x_ps, W, mult, 3);
+            }
+        }
+
+        Color8 col = ColorCombiner8<pp_Texture, pp_Offset>(tsp.ShadInstr, base, textel, offs);
+
+        col = FogUnit8<pp_Offset, pp_ColorClamp, pp_FogCtrl>(col, 1.0f / W, offs.bgra[3], lanes);
+
+        AlphaTestPassed |= BlendingUnit8(tile, tsp, pp_AlphaTest, y * 32 + gx, lanes, col) << gx;
+    }
+
+    if (pp_Texture && pp_Offset) {
+        // the offset color persists in the tile, as left by the last pixel
+        for (int c = 0; c < 4; c++)
+            tile->offs.bgra[c] = offs.bgra[c][x1 & 7];
+        tile->offsWritten = true;
+    }
+
+    return AlphaTestPassed;
+}
+#else
+// Without vector support, the pixels of the span go through the scalar pipeline one by one
+template<bool pp_UseAlpha, bool pp_Texture, bool pp_Offset, bool pp_ColorClamp, uint32_t pp_FogCtrl, bool pp_CheapShadows>
+static uint32_t PixelFlush_tspSpan(TileContext* tile, const FpuEntry *entry, float halfpixel, int y, int x0, int x1, bool InVolume, bool pp_AlphaTest)
+{
+    uint32_t two_voume_index = InVolume & !pp_CheapShadows;
+    auto blending = entry->pipeline[two_voume_index].blending[pp_AlphaTest];
+    uint32_t AlphaTestPassed = 0;
+
+    for (int x = x0; x <= x1; x++) {
+        float x_ps = x + halfpixel, y_ps = y + halfpixel;
+        auto invW = entry->ips.invW.Ip(x_ps, y_ps);
+
+        if (PixelFlush_tsp<pp_UseAlpha, pp_Texture, pp_Offset, pp_ColorClamp, pp_FogCtrl, pp_CheapShadows>(tile, entry, x_ps, y_ps, 1/invW, InVolume, y * 32 + x, blending))
+            AlphaTestPassed |= 1u << x;
+    }
+
+    return AlphaTestPassed;
+}
+#endif
+
+using RasterizeTriangle_fp = decltype(&RasterizeTriangle<0,0,0,0>);
+using RasterizeStrip_fp = decltype(&RasterizeStrip<0,0,0>);
 
-    RENDLOG("TSP: %d %f %f %d %f %d %08X %08X %08X %08X", index, x, y, InVolume, invW, pp_AlphaTest, entry->params.isp.full, entry->params.tsp[two_voume_index].full, entry->params.tcw[two_voume_index].full, core_tag.full);
-
-    auto fetch = TextureFetch_table
-        [entry->params.tcw[two_voume_index].VQ_Comp]
-        [entry->params.tcw[two_voume_index].MipMapped]
-        [entry->params.tcw[two_voume_index].ScanOrder]
-        [entry->params.tcw[two_voume_index].StrideSel]
-        [entry->params.tcw[two_voume_index].PixelFmt];
-
-    auto filter = TextureFilter_table
-        [entry->params.tsp[two_voume_index].IgnoreTexA]
-        [entry->params.tsp[two_voume_index].ClampU]
-        [entry->params.tsp[two_voume_index].ClampV]
-        [entry->params.tsp[two_voume_index].FlipU]
-        [entry->params.tsp[two_voume_index].FlipV]
-        [entry->params.tsp[two_voume_index].FilterMode];
-
-    auto combiner = ColorCombiner_table
-        [entry->params.isp.Texture]
-        [entry->params.isp.Offset]
-        [entry->params.tsp[two_voume_index].ShadInstr];
-
-    auto blending = BlendingUnit_table
-        [entry->params.tsp[two_voume_index].SrcSelect]
-        [entry->params.tsp[two_voume_index].DstSelect]
-        [entry->params.tsp[two_voume_index].SrcInstr]
-        [entry->params.tsp[two_voume_index].DstInstr]
-        [pp_AlphaTest];
+#include "gentable.h"
+
+// Resolve the TSP pipeline of a volume from its parameters
+static void ResolveTspPipeline(TspPipeline* pipeline, const DrawParameters* params, uint32_t two_voume_index)
+{
+    auto& rv = *pipeline;
+
+    rv.fetch = TextureFetch_table
+        [params->tcw[two_voume_index].VQ_Comp]
+        [params->tcw[two_voume_index].MipMapped]
+        [params->tcw[two_voume_index].ScanOrder]
+        [params->tcw[two_voume_index].StrideSel]
+        [params->tcw[two_voume_index].PixelFmt];
+
+    rv.filter = TextureFilter_table
+        [params->tsp[two_voume_index].IgnoreTexA]
+        [params->tsp[two_voume_index].ClampU]
+        [params->tsp[two_voume_index].ClampV]
+        [params->tsp[two_voume_index].FlipU]
+        [params->tsp[two_voume_index].FlipV]
+        [params->tsp[two_voume_index].FilterMode];
+
+    rv.combiner = ColorCombiner_table
+        [params->isp.Texture]
+        [params->isp.Offset]
+        [params->tsp[two_voume_index].ShadInstr];
+
+    for (int pp_AlphaTest = 0; pp_AlphaTest < 2; pp_AlphaTest++) {
+        rv.blending[pp_AlphaTest] = BlendingUnit_table
+            [params->tsp[two_voume_index].SrcSelect]
+            [params->tsp[two_voume_index].DstSelect]
+            [params->tsp[two_voume_index].SrcInstr]
+            [params->tsp[two_voume_index].DstInstr]
+            [pp_AlphaTest];
+    }
     
-    auto pixel = PixelFlush_tsp_table
-        [entry->params.tsp[two_voume_index].UseAlpha]
-        [entry->params.isp.Texture]
-        [entry->params.isp.Offset]
-        [entry->params.tsp[two_voume_index].ColorClamp]
-        [entry->params.tsp[two_voume_index].FogCtrl]
+    rv.pixel = PixelFlush_tsp_table
+        [params->tsp[two_voume_index].UseAlpha]
+        [params->isp.Texture]
+        [params->isp.Offset]
+        [params->tsp[two_voume_index].ColorClamp]
+        [params->tsp[two_voume_index].FogCtrl]
         [FPU_SHAD_SCALE.intensity_shadow];
 
-    return pixel(entry, x, y, 1/invW, InVolume, index, fetch, filter, combiner, blending);
+    rv.span = PixelFlush_tspSpan_table
+        [params->tsp[two_voume_index].UseAlpha]
+        [params->isp.Texture]
+        [params->isp.Offset]
+        [params->tsp[two_voume_index].ColorClamp]
+        [params->tsp[two_voume_index].FogCtrl]
+        [FPU_SHAD_SCALE.intensity_shadow];
+}
+
+// Shade the pixels [x0, x1] of row y, which share a tag and volume, with one pipeline lookup
+uint32_t ShadeSpan(TileContext* tile, bool pp_AlphaTest, const FpuEntry* entry, float halfpixel, int y, int x0, int x1, bool InVolume, [[maybe_unused]] ISP_BACKGND_T_type core_tag)
+{
+    uint32_t two_voume_index = InVolume & !FPU_SHAD_SCALE.intensity_shadow;
+    const auto& pipeline = entry->pipeline[two_voume_index];
+    auto blending = pipeline.blending[pp_AlphaTest];
+
+    uint32_t AlphaTestPassed = 0;
+
+#if defined(REFSW_SIMD)
+    // Bump mapping and texture dumps only exist in the scalar pipeline
+    bool bumpMap = entry->params.isp.Texture && entry->params.tcw[two_voume_index].PixelFmt == PixelBumpMap;
+    if (!bumpMap && !dump_textures) {
+#if defined(REFSW_VERIFY_TSP)
+        // Run the scalar pipeline on a copy of the row first, the vector one must match it exactly
+        uint32_t row1[32], row2[32], AlphaTestExpected = 0;
+        Color offsIn = tile->offs;
+        memcpy(row1, tile->colorBuffer1 + y * 32, sizeof(row1));
+        memcpy(row2, tile->colorBuffer2 + y * 32, sizeof(row2));
+
+        for (int x = x0; x <= x1; x++) {
+            float x_ps = x + halfpixel, y_ps = y + halfpixel;
+            auto invW = entry->ips.invW.Ip(x_ps, y_ps);
+
+            if (pipeline.pixel(tile, entry, x_ps, y_ps, 1/invW, InVolume, y * 32 + x, blending))
+                AlphaTestExpected |= 1u << x;
+        }
+
+        uint32_t exp1[32], exp2[32];
+        Color offsExpected = tile->offs;
+        memcpy(exp1, tile->colorBuffer1 + y * 32, sizeof(exp1));
+        memcpy(exp2, tile->colorBuffer2 + y * 32, sizeof(exp2));
+        memcpy(tile->colorBuffer1 + y * 32, row1, sizeof(row1));
+        memcpy(tile->colorBuffer2 + y * 32, row2, sizeof(row2));
+        tile->offs = offsIn;
+#endif
+
+        AlphaTestPassed = pipeline.span(tile, entry, halfpixel, y, x0, x1, InVolume, pp_AlphaTest);
+
+#if defined(REFSW_VERIFY_TSP)
+        tile->verifiedSpans++;
+        if (AlphaTestPassed != AlphaTestExpected || tile->offs.raw != offsExpected.raw ||
+            memcmp(exp1, tile->colorBuffer1 + y * 32, sizeof(exp1)) || memcmp(exp2, tile->colorBuffer2 + y * 32, sizeof(exp2))) {
+            tile->verifyMismatches++;
+            die("Missmatch");
+        }
+#endif
+
+        return AlphaTestPassed;
+    }
+#endif
+
+    for (int x = x0; x <= x1; x++) {
+        uint32_t index = y * 32 + x;
+        float x_ps = x + halfpixel, y_ps = y + halfpixel;
+        auto invW = entry->ips.invW.Ip(x_ps, y_ps);
+
+        RENDLOG("TSP: %d %f %f %d %f %d %08X %08X %08X %08X", index, x_ps, y_ps, InVolume, invW, pp_AlphaTest, entry->params.isp.full, entry->params.tsp[two_voume_index].full, entry->params.tcw[two_voume_index].full, core_tag.full);
+
+        if (pipeline.pixel(tile, entry, x_ps, y_ps, 1/invW, InVolume, index, blending))
+            AlphaTestPassed |= 1u << x;
+    }
+
+    return AlphaTestPassed;
 }
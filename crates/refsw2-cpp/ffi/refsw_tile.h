@@ -12,6 +12,8 @@
 
 #include "refsw_lists.h"
 
+#include <vector>
+
 // For texture cache
 
 #define MAX_RENDER_WIDTH 32
@@ -22,7 +24,7 @@
 
 
 typedef float    ZType;
-typedef uint8_t       StencilType;
+typedef uint32_t      StencilType;     // one bit per pixel of a tile row
 typedef uint32_t      ColorType;
 /*
     Surface equation solver
@@ -33,6 +35,14 @@ struct PlaneStepper3
     float c;
 
     void Setup(taRECT *rect, const Vertex& v1, const Vertex& v2, const Vertex& v3, float v1_a, float v2_a, float v3_a)
+    {
+        SetupScreen(v1, v2, v3, v1_a, v2_a, v3_a);
+        *this = ToTile(rect, v1);
+    }
+
+    // The slopes of the plane, with c holding its value at v1 until ToTile moves it to a tile origin.
+    // This part doesn't depend on the tile, so it can be shared by all the tiles of a triangle
+    void SetupScreen(const Vertex& v1, const Vertex& v2, const Vertex& v3, float v1_a, float v2_a, float v3_a)
     {
         float Aa = ((v3_a - v1_a) * (v2.y - v1.y) - (v2_a - v1_a) * (v3.y - v1.y));
         float Ba = ((v3.x - v1.x) * (v2_a - v1_a) - (v2.x - v1.x) * (v3_a - v1_a));
@@ -46,7 +56,12 @@ struct PlaneStepper3
         ddx = -Aa / C;
         ddy = -Ba / C;
 
-        c = v1_a - ddx * (v1.x - rect->left) - ddy * (v1.y - rect->top);
+        c = v1_a;
+    }
+
+    PlaneStepper3 ToTile(taRECT *rect, const Vertex& v1) const
+    {
+        return { ddx, ddy, c - ddx * (v1.x - rect->left) - ddy * (v1.y - rect->top) };
     }
 
     float Ip(float x, float y) const
@@ -81,50 +96,61 @@ struct IPs3
     PlaneStepper3 Col[2][4];
     PlaneStepper3 Ofs[2][4];
 
-    void Setup(taRECT *rect, DrawParameters* params, const Vertex& v1, const Vertex& v2, const Vertex& v3, bool TwoVolumes)
+    // Only the planes the TSP reads are set up: invW and Col always, U/V for textured
+    // polygons and Ofs when the offset color is also used. Volume 1 is set up separately,
+    // the first time a pixel inside the volume is shaded.
+    // The planes are set up in screen space, see PlaneStepper3::SetupScreen, and moved to a tile with ToTile
+    void Setup(DrawParameters* params, const Vertex& v1, const Vertex& v2, const Vertex& v3)
     {
-        invW.Setup(rect, v1, v2, v3, v1.z, v2.z, v3.z);
-        U[0].Setup(rect, v1, v2, v3, v1.u * v1.z, v2.u * v2.z, v3.u * v3.z);
-        V[0].Setup(rect, v1, v2, v3, v1.v * v1.z, v2.v * v2.z, v3.v * v3.z);
-        if (params->isp.Gouraud) {
-            for (int i = 0; i < 4; i++)
-                Col[0][i].Setup(rect, v1, v2, v3, v1.col[i] * v1.z, v2.col[i] * v2.z, v3.col[i] * v3.z);
-
-            for (int i = 0; i < 4; i++)
-                Ofs[0][i].Setup(rect, v1, v2, v3, v1.spc[i] * v1.z, v2.spc[i] * v2.z, v3.spc[i] * v3.z);
-        } else {
-            for (int i = 0; i < 4; i++)
-                Col[0][i].Setup(rect, v1, v2, v3, v3.col[i] * v1.z, v3.col[i] * v2.z, v3.col[i] * v3.z);
-
-            for (int i = 0; i < 4; i++)
-                Ofs[0][i].Setup(rect, v1, v2, v3, v3.spc[i] * v1.z, v3.spc[i] * v2.z, v3.spc[i] * v3.z);
-        }
+        invW.SetupScreen(v1, v2, v3, v1.z, v2.z, v3.z);
+        SetupVolume(params, v1, v2, v3, 0);
+    }
 
-        if (TwoVolumes) {
-            U[1].Setup(rect, v1, v2, v3, v1.u1 * v1.z, v2.u1 * v2.z, v3.u1 * v3.z);
-            V[1].Setup(rect, v1, v2, v3, v1.v1 * v1.z, v2.v1 * v2.z, v3.v1 * v3.z);
-            if (params->isp.Gouraud) {
-                for (int i = 0; i < 4; i++)
-                    Col[1][i].Setup(rect, v1, v2, v3, v1.col1[i] * v1.z, v2.col1[i] * v2.z, v3.col1[i] * v3.z);
+    void SetupVolume(DrawParameters* params, const Vertex& v1, const Vertex& v2, const Vertex& v3, uint32_t volume)
+    {
+        // Flat shaded polygons take their colors from the last vertex
+        const Vertex& c1 = params->isp.Gouraud ? v1 : v3;
+        const Vertex& c2 = params->isp.Gouraud ? v2 : v3;
 
-                for (int i = 0; i < 4; i++)
-                    Ofs[1][i].Setup(rect, v1, v2, v3, v1.spc1[i] * v1.z, v2.spc1[i] * v2.z, v3.spc1[i] * v3.z);
+        auto col = [volume](const Vertex& v) { return volume ? v.col1 : v.col; };
+        auto spc = [volume](const Vertex& v) { return volume ? v.spc1 : v.spc; };
+
+        for (int i = 0; i < 4; i++)
+            Col[volume][i].SetupScreen(v1, v2, v3, col(c1)[i] * v1.z, col(c2)[i] * v2.z, col(v3)[i] * v3.z);
+
+        if (params->isp.Texture) {
+            if (volume) {
+                U[1].SetupScreen(v1, v2, v3, v1.u1 * v1.z, v2.u1 * v2.z, v3.u1 * v3.z);
+                V[1].SetupScreen(v1, v2, v3, v1.v1 * v1.z, v2.v1 * v2.z, v3.v1 * v3.z);
             } else {
-                for (int i = 0; i < 4; i++)
-                    Col[1][i].Setup(rect, v1, v2, v3, v3.col1[i] * v1.z, v3.col1[i] * v2.z, v3.col1[i] * v3.z);
+                U[0].SetupScreen(v1, v2, v3, v1.u * v1.z, v2.u * v2.z, v3.u * v3.z);
+                V[0].SetupScreen(v1, v2, v3, v1.v * v1.z, v2.v * v2.z, v3.v * v3.z);
+            }
 
+            if (params->isp.Offset) {
                 for (int i = 0; i < 4; i++)
-                    Ofs[1][i].Setup(rect, v1, v2, v3, v3.spc1[i] * v1.z, v3.spc1[i] * v2.z, v3.spc1[i] * v3.z);
+                    Ofs[volume][i].SetupScreen(v1, v2, v3, spc(c1)[i] * v1.z, spc(c2)[i] * v2.z, spc(v3)[i] * v3.z);
             }
         }
     }
-};
 
-// Used for deferred TSP processing lookups
-struct FpuEntry
-{
-    IPs3 ips;
-    DrawParameters params;
+    // Move the planes of a volume, as set up by SetupVolume, from screen space to the origin of rect.
+    // invW is moved separately, as the rasterizer may have set it up already, see GetFpuEntry
+    void ToTile(const IPs3& screen, taRECT *rect, DrawParameters* params, const Vertex& v1, uint32_t volume)
+    {
+        for (int i = 0; i < 4; i++)
+            Col[volume][i] = screen.Col[volume][i].ToTile(rect, v1);
+
+        if (params->isp.Texture) {
+            U[volume] = screen.U[volume].ToTile(rect, v1);
+            V[volume] = screen.V[volume].ToTile(rect, v1);
+
+            if (params->isp.Offset) {
+                for (int i = 0; i < 4; i++)
+                    Ofs[volume][i] = screen.Ofs[volume][i].ToTile(rect, v1);
+            }
+        }
+    }
 };
 
 union Color {
@@ -138,24 +164,198 @@ union Color {
     };
 };
 
-extern uint32_t  colorBuffer1 [MAX_RENDER_PIXELS];
+struct TileContext;
+struct FpuEntry;
+
+// TSP pipeline stages, specialized on the parameters that select them
+typedef Color (*TextureFetch_fp)(TSP tsp, TCW tcw, int u, int v, uint32_t MipLevel);
+typedef Color (*TextureFilter_fp)(TSP tsp, TCW tcw, float u, float v, uint32_t MipLevel, float dTrilinear, TextureFetch_fp fetch);
+typedef Color (*ColorCombiner_fp)(Color base, Color textel, Color offset);
+typedef bool (*BlendingUnit_fp)(TileContext* tile, uint32_t index, Color col);
+typedef bool (*PixelFlush_tsp_fp)(TileContext* tile, const FpuEntry *entry, float x, float y, float W, bool InVolume, uint32_t index, BlendingUnit_fp blending);
+typedef uint32_t (*PixelFlush_tspSpan_fp)(TileContext* tile, const FpuEntry *entry, float halfpixel, int y, int x0, int x1, bool InVolume, bool pp_AlphaTest);
+
+// TSP pipeline of one volume of a tag. PixelFlush_tsp calls the other stages through it
+struct TspPipeline
+{
+    TextureFetch_fp fetch;
+    TextureFilter_fp filter;
+    ColorCombiner_fp combiner;
+    BlendingUnit_fp blending[2];    // [pp_AlphaTest]
+    PixelFlush_tsp_fp pixel;
+    PixelFlush_tspSpan_fp span;     // a whole span, 8 pixels at a time
+};
+
+// Used for deferred TSP processing lookups
+struct FpuEntry
+{
+    IPs3 ips;
+    DrawParameters params;
+    TspPipeline pipeline[2];        // [two_voume_index], resolved by GetFpuEntry
+};
+
+// Setup of a tag that doesn't depend on the tile, see TileContext::setupCache
+struct FrameSetup
+{
+    uint32_t tag;
+    uint32_t frame;
+    bool twoVolumes;
+    bool volume1Ready;
+    DrawParameters params;
+    TspPipeline pipeline[2];
+    IPs3 ips;               // in screen space
+    Vertex vtx[3];
+};
+
+// Entries of TileContext::setupCache
+constexpr size_t SETUP_CACHE_SIZE = 1024;
+
+// A tag rasterized or met by the TSP in a tile, see TileContext::triangles
+struct TileTriangle
+{
+    uint32_t tag;
+    bool ready;             // volume 0 is set up, on the first TSP use, see GetFpuEntry
+    bool rasterZ;           // invW is the Z plane of the rasterizer, see AddTileTriangle
+    bool volume1Ready;      // volume 1 is set up on demand, see GetFpuEntry
+    FpuEntry entry;
+};
+
+/*
+    Tile buffers and per-tile caches
+
+    Everything CORE keeps between the object lists of a region array entry lives here, so
+    that tiles can be rendered concurrently by giving each worker its own TileContext.
+*/
+// A primitive as seen by the ISP in one tile: its coverage rows and depth plane
+struct CoveredPrimitive
+{
+    parameter_tag_t tag;
+    PlaneStepper3 Z;
+    uint8_t miny, maxy;     // rows with coverage
+    uint32_t firstRow;      // index of the row miny in TileContext::coverageRows
+};
+
+// Coverage cache limit, in rows. Lists that need more are walked again on every pass
+constexpr size_t MAX_COVERAGE_ROWS = 1 << 18;
+
+/*
+    Modifier volume stencil, as bitplanes with one word per tile row
+*/
+struct StencilPlanes
+{
+    StencilType inside[MAX_RENDER_HEIGHT];      // summarized volume status, read by the TSP
+    StencilType parity[MAX_RENDER_HEIGHT];      // flipped by every volume triangle that passes depth
+    StencilType touched[MAX_RENDER_HEIGHT];     // pixels with a parity pending for the summary
+
+    void Clear(uint32_t stencilValue)
+    {
+        for (int y = 0; y < MAX_RENDER_HEIGHT; y++) {
+            inside[y] = (stencilValue & 0b001) ? ~0u : 0;
+            parity[y] = (stencilValue & 0b010) ? ~0u : 0;
+            touched[y] = (stencilValue & 0b100) ? ~0u : 0;
+        }
+    }
+
+    bool Inside(uint32_t index) const
+    {
+        return (inside[index / MAX_RENDER_WIDTH] >> (index % MAX_RENDER_WIDTH)) & 1;
+    }
+
+    // The stencil bits of a pixel as status | parity << 1 | touched << 2
+    uint32_t Pixel(uint32_t index) const
+    {
+        uint32_t y = index / MAX_RENDER_WIDTH, x = index % MAX_RENDER_WIDTH;
+        return ((inside[y] >> x) & 1) | (((parity[y] >> x) & 1) << 1) | (((touched[y] >> x) & 1) << 2);
+    }
+
+    // Flip the parity of the pixels in mask, and mark them valid for the summary
+    void Flip(int y, StencilType mask)
+    {
+        parity[y] ^= mask;
+        touched[y] |= mask;
+    }
+};
+
+struct TileContext
+{
+    TagState        tagStatus;
+    parameter_tag_t tagBuffer[2] [MAX_RENDER_PIXELS];
+    StencilPlanes   stencil;
+    uint32_t        colorBuffer1 [MAX_RENDER_PIXELS];
+    uint32_t        colorBuffer2 [MAX_RENDER_PIXELS];
+    ZType           depthBuffer[3] [MAX_RENDER_PIXELS];
+
+    // Tags rasterized or shaded in the current region array entry, with their setup moved to the tile.
+    // triangleIndex is an open addressed hash of the tags, holding indices into triangles + 1
+    std::vector<TileTriangle> triangles;
+    std::vector<uint32_t> triangleIndex;
+
+    // Screen space setup of the tags seen this frame, shared by all the tiles this context renders.
+    // Direct mapped, entries from earlier frames are told apart by setupFrame
+    std::vector<FrameSetup> setupCache;
+    uint32_t setupFrame = 0;
+    uint64_t setupHits = 0;
+    uint64_t setupMisses = 0;
+
+    // spans of the current frame checked against the scalar pipeline, when built with REFSW_VERIFY_TSP
+    uint64_t verifiedSpans = 0;
+    uint64_t verifyMismatches = 0;
+
+    bool MoreToDraw;
+
+    // rasterize with integer edge equations instead of float ones
+    bool fixedPointRaster = false;
+
+    // hierarchical Z, a lower bound of depth buffer A per 8x8 block, rebuilt when hizValid is cleared
+    ZType hizMin[MAX_RENDER_HEIGHT / 8][MAX_RENDER_WIDTH / 8];
+    bool hizValid = false;
+
+    // this one persists across invocations, as tested via bump maps. Default value was randomly chosen.
+    Color offs = { 0x20004080 };
+    bool offsWritten = false;   // set when the TSP writes offs, see TileWorkers
+
+    // framebuffer rows written out by this context during the current frame
+    std::vector<uint32_t> writeoutRows;
+
+    // coverage of the primitives of a multipass list, recorded in its first pass, see RenderCoverageCache
+    std::vector<CoveredPrimitive> coverage;
+    std::vector<uint32_t> coverageRows;
+    bool coverageRecording = false;
+    bool coverageValid = false;
+
+    // coverage of the primitive being rasterized while recording, one bit per pixel
+    uint32_t primitiveRows[32];
+    PlaneStepper3 primitiveZ;
+};
+
 extern const char* dump_textures;
 
-void ClearBuffers(uint32_t paramValue, float depthValue, uint32_t stencilValue);
-void ClearParamStatusBuffer();
-void SetTagToMax();
-void PeelBuffers(float depthValue, uint32_t stencilValue);
-void PeelBuffersPT();
-void PeelBuffersPTInitial(float depthValue);
-void SummarizeStencilOr();
-void SummarizeStencilAnd();
-void ClearMoreToDraw();
-bool GetMoreToDraw();
+void ClearBuffers(TileContext* tile, uint32_t paramValue, float depthValue, uint32_t stencilValue);
+void ClearParamStatusBuffer(TileContext* tile);
+void SetTagToMax(TileContext* tile);
+void PeelBuffers(TileContext* tile, float depthValue, uint32_t stencilValue);
+void PeelBuffersPT(TileContext* tile);
+void PeelBuffersPTInitial(TileContext* tile, float depthValue);
+void SummarizeStencilOr(TileContext* tile);
+void SummarizeStencilAnd(TileContext* tile);
+void ClearMoreToDraw(TileContext* tile);
+bool GetMoreToDraw(TileContext* tile);
+bool HasShadowedTags(TileContext* tile, bool rendered);
+
+// Coverage cache for the passes of punch through and autosort lists.
+// Coverage doesn't depend on the buffers, so later passes replay only the ISP depth and tag logic
+void BeginCoverageCache(TileContext* tile);
+void EndCoverageCache(TileContext* tile);
+void BeginPrimitiveCoverage(TileContext* tile);
+void EndPrimitiveCoverage(TileContext* tile, parameter_tag_t tag);
+template<RenderMode render_mode>
+void RenderCoverageCache(TileContext* tile);
 
 // Render to ACCUM from TAG buffer
 // TAG holds references to triangles, ACCUM is the tile framebuffer
+// Only the rows set in rows are shaded
 template<RenderMode rm>
-void RenderParamTags(int tileX, int tileY);
+void RenderParamTags(TileContext* tile, int tileX, int tileY, uint32_t rows = ~0u);
 
 inline float f16(uint16_t v)
 {
@@ -167,30 +367,66 @@ inline float f16(uint16_t v)
 void decode_pvr_vertex(DrawParameters* params, pvr32addr_t ptr,Vertex* cv, uint32_t shadow);
 // decode an object (params + vertexes)
 uint32_t decode_pvr_vertices(DrawParameters* params, pvr32addr_t base, uint32_t skip, uint32_t two_volumes, Vertex* vtx, int count, int offset);
+// decode the isp word and vertex positions of an object (params->isp + xyz)
+uint32_t decode_pvr_positions(DrawParameters* params, pvr32addr_t base, uint32_t skip, uint32_t two_volumes, Vertex* vtx, int count);
+
+const FpuEntry& GetFpuEntry(TileContext* tile, taRECT *rect, ISP_BACKGND_T_type core_tag, bool InVolume);
+// Shade a span of pixels with the same tag and volume with PixelFlush_tsp, returns the alpha test result of each pixel (bit x)
+uint32_t ShadeSpan(TileContext* tile, bool pp_AlphaTest, const FpuEntry* entry, float halfpixel, int y, int x0, int x1, bool InVolume, ISP_BACKGND_T_type core_tag);
+// Rasterize a single triangle to ISP (or ISP+TSP for PT), returns the rows it rasterized
+
+// [RenderMode][isp.DepthMode][isp.ZWriteDis][v4 != nullptr]
+extern uint32_t (*RasterizeTriangle_table[7][8][2][2])(TileContext* tile, DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area);
 
-const FpuEntry& GetFpuEntry(taRECT *rect, RenderMode render_mode, ISP_BACKGND_T_type core_tag);
-// Lookup/create cached TSP parameters, and call PixelFlush_tsp
-bool PixelFlush_tsp(bool pp_AlphaTest, const FpuEntry* entry, float x, float y, uint32_t index, float invW, bool InVolume, ISP_BACKGND_T_type core_tag);
-// Rasterize a single triangle to ISP (or ISP+TSP for PT)
+// A triangle of a strip, with its vertices already in drawing order
+struct StripTriangle
+{
+    parameter_tag_t tag;
+    const Vertex* v1;
+    const Vertex* v2;
+    const Vertex* v3;
+};
 
-extern void (*RasterizeTriangle_table[])(DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area);
+// Rasterize up to 6 strip triangles to ISP in one pass, for RM_OPAQUE .. RM_TRANSLUCENT_AUTOSORT
+// [RenderMode][isp.DepthMode][isp.ZWriteDis]
+extern void (*RasterizeStrip_table[5][8][2])(TileContext* tile, DrawParameters* params, const StripTriangle* triangles, int count, taRECT* area);
 
-uint8_t* GetColorOutputBuffer();
+uint8_t* GetColorOutputBuffer(TileContext* tile);
 
 
 /*
     Main renderer class
 */
 
-void RenderTriangle(RenderMode render_mode, DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area);
+void RenderTriangle(TileContext* tile, RenderMode render_mode, DrawParameters* params, parameter_tag_t tag, const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex* v4, taRECT* area);
 // called on vblank
 bool RenderFramebuffer();
 uint32_t ReadRegionArrayEntry(uint32_t base, RegionArrayEntry* entry);
 ISP_BACKGND_T_type CoreTagFromDesc(uint32_t cache_bypass, uint32_t shadow, uint32_t skip, uint32_t param_offs_in_words, uint32_t tag_offset);
-void RenderTriangleStrip(RenderMode render_mode, ObjectListEntry obj, taRECT* rect);
-void RenderTriangleArray(RenderMode render_mode, ObjectListEntry obj, taRECT* rect);
-void RenderQuadArray(RenderMode render_mode, ObjectListEntry obj, taRECT* rect);
-void RenderObjectList(RenderMode render_mode, pvr32addr_t base, taRECT* rect);
-void RenderCORE();
+void RenderTriangleStrip(TileContext* tile, RenderMode render_mode, ObjectListEntry obj, taRECT* rect);
+void RenderTriangleArray(TileContext* tile, RenderMode render_mode, ObjectListEntry obj, taRECT* rect);
+void RenderQuadArray(TileContext* tile, RenderMode render_mode, ObjectListEntry obj, taRECT* rect);
+void RenderObjectList(TileContext* tile, RenderMode render_mode, pvr32addr_t base, taRECT* rect);
+void RenderRegionEntry(TileContext* tile, const RegionArrayEntry& entry);
+
+struct RefswContext;
+RefswContext* CreateRefswContext();
+void DestroyRefswContext(RefswContext* ctx);
+void RenderCORE(RefswContext* ctx);
+// Number of tile workers used by RenderCORE. 0 picks one per hardware thread, 1 renders serially.
+void SetRenderThreads(RefswContext* ctx, uint32_t threads);
+void SetFixedPointRaster(RefswContext* ctx, bool enable);
+// Start rendering a frame from a snapshot of VRAM and registers on a background thread
+void RenderCOREAsync(RefswContext* ctx, uint8_t* vram, const uint32_t* regs);
+// Returns true once the frame started by RenderCOREAsync is done and written back to VRAM
+bool PollRenderCORE(RefswContext* ctx);
+void WaitRenderCORE(RefswContext* ctx);
 void Hackpresent();
-void ClearFpuCache();
\ No newline at end of file
+// Empty the triangle table of the tile, see GetFpuEntry
+void ClearFpuCache(TileContext* tile);
+// Start a new frame in the setup cache of a context, and reset its statistics
+void ClearSetupCache(TileContext* tile);
+// Setup cache lookups of the last frame rendered, over all the tile contexts
+void GetSetupCacheStats(RefswContext* ctx, uint64_t* hits, uint64_t* misses);
+// Spans of the last frame checked against the scalar pipeline, and the ones that differed
+void GetVerifyStats(RefswContext* ctx, uint64_t* spans, uint64_t* mismatches);
\ No newline at end of file
@@ -6,10 +6,28 @@
 
 #![allow(dead_code)]
 
+/// Opaque renderer instance, see `create_context`
+#[repr(C)]
+pub struct RefswContext {
+    _private: [u8; 0],
+}
+
 // C++ FFI functions
 unsafe extern "C" {
     fn ffi_refsw2_init();
     fn ffi_refsw2_render(vram: *mut u8, regs: *const u32);
+    fn ffi_refsw2_set_threads(threads: u32);
+    fn ffi_refsw2_set_fixed_point(enable: bool);
+    fn ffi_refsw2_create_context() -> *mut RefswContext;
+    fn ffi_refsw2_destroy_context(ctx: *mut RefswContext);
+    fn ffi_refsw2_render_ctx(ctx: *mut RefswContext, vram: *mut u8, regs: *const u32);
+    fn ffi_refsw2_set_threads_ctx(ctx: *mut RefswContext, threads: u32);
+    fn ffi_refsw2_set_fixed_point_ctx(ctx: *mut RefswContext, enable: bool);
+    fn ffi_refsw2_render_async(ctx: *mut RefswContext, vram: *mut u8, regs: *const u32);
+    fn ffi_refsw2_render_poll(ctx: *mut RefswContext) -> bool;
+    fn ffi_refsw2_render_wait(ctx: *mut RefswContext);
+    fn ffi_refsw2_setup_cache_stats(ctx: *mut RefswContext, hits: *mut u64, misses: *mut u64);
+    fn ffi_refsw2_verify_stats(ctx: *mut RefswContext, spans: *mut u64, mismatches: *mut u64);
 }
 
 /// Initialize the C++ renderer backend
@@ -29,3 +47,118 @@ pub unsafe fn render(vram: *mut u8, regs: *const u32) {
         ffi_refsw2_render(vram, regs);
     }
 }
+
+/// Set the number of tile rendering threads
+///
+/// # Arguments
+/// * `threads` - Number of workers, 0 for one per hardware thread, 1 for serial rendering
+pub unsafe fn set_threads(threads: u32) {
+    unsafe {
+        ffi_refsw2_set_threads(threads);
+    }
+}
+
+/// Rasterize with fixed point edge equations instead of float ones
+///
+/// Vertices are snapped to 1/16th of a pixel and edges are evaluated exactly, with a
+/// strict top-left rule. Off by default, as float rasterization matches the reference.
+pub unsafe fn set_fixed_point(enable: bool) {
+    unsafe {
+        ffi_refsw2_set_fixed_point(enable);
+    }
+}
+
+/// Create an independent renderer instance
+///
+/// Different contexts can render concurrently from different threads.
+pub unsafe fn create_context() -> *mut RefswContext {
+    unsafe { ffi_refsw2_create_context() }
+}
+
+/// Destroy a renderer instance created with `create_context`
+pub unsafe fn destroy_context(ctx: *mut RefswContext) {
+    unsafe {
+        ffi_refsw2_destroy_context(ctx);
+    }
+}
+
+/// Render a frame using a specific renderer instance
+///
+/// # Arguments
+/// * `ctx` - Renderer instance from `create_context`
+/// * `vram` - Pointer to emulated VRAM (8MB)
+/// * `regs` - Pointer to emulated PVR registers
+pub unsafe fn render_ctx(ctx: *mut RefswContext, vram: *mut u8, regs: *const u32) {
+    unsafe {
+        ffi_refsw2_render_ctx(ctx, vram, regs);
+    }
+}
+
+/// Set the number of tile rendering threads of a renderer instance
+pub unsafe fn set_threads_ctx(ctx: *mut RefswContext, threads: u32) {
+    unsafe {
+        ffi_refsw2_set_threads_ctx(ctx, threads);
+    }
+}
+
+/// Enable fixed point rasterization for a renderer instance, see `set_fixed_point`
+pub unsafe fn set_fixed_point_ctx(ctx: *mut RefswContext, enable: bool) {
+    unsafe {
+        ffi_refsw2_set_fixed_point_ctx(ctx, enable);
+    }
+}
+
+/// Start rendering a frame on a background thread
+///
+/// VRAM and registers are snapshotted before this returns. The rendered framebuffer is
+/// written to `vram` by `render_poll` / `render_wait`, which must be called from the
+/// thread that owns `vram`.
+///
+/// # Arguments
+/// * `ctx` - Renderer instance from `create_context`
+/// * `vram` - Pointer to emulated VRAM (8MB)
+/// * `regs` - Pointer to emulated PVR registers
+pub unsafe fn render_async(ctx: *mut RefswContext, vram: *mut u8, regs: *const u32) {
+    unsafe {
+        ffi_refsw2_render_async(ctx, vram, regs);
+    }
+}
+
+/// Returns true once no asynchronous frame is pending anymore
+pub unsafe fn render_poll(ctx: *mut RefswContext) -> bool {
+    unsafe { ffi_refsw2_render_poll(ctx) }
+}
+
+/// Block until the pending asynchronous frame, if any, is done
+pub unsafe fn render_wait(ctx: *mut RefswContext) {
+    unsafe {
+        ffi_refsw2_render_wait(ctx);
+    }
+}
+
+/// Triangle setup cache statistics of the last frame rendered, as `(hits, misses)`
+///
+/// Each miss is a triangle set up in screen space. Each hit is a lookup that reused one,
+/// only applying its offset. Waits for a pending asynchronous frame.
+pub unsafe fn setup_cache_stats(ctx: *mut RefswContext) -> (u64, u64) {
+    let mut hits = 0;
+    let mut misses = 0;
+    unsafe {
+        ffi_refsw2_setup_cache_stats(ctx, &mut hits, &mut misses);
+    }
+    (hits, misses)
+}
+
+/// TSP verification statistics of the last frame rendered, as `(spans, mismatches)`
+///
+/// With the `verify-tsp` feature every span shaded by the vector pipeline is first shaded
+/// by the scalar one, and must match it exactly. A mismatch also fails an assertion in
+/// debug builds. Both are 0 without the feature. Waits for a pending asynchronous frame.
+pub unsafe fn verify_stats(ctx: *mut RefswContext) -> (u64, u64) {
+    let mut spans = 0;
+    let mut mismatches = 0;
+    unsafe {
+        ffi_refsw2_verify_stats(ctx, &mut spans, &mut mismatches);
+    }
+    (spans, mismatches)
+}
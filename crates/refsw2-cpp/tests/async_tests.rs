@@ -0,0 +1,39 @@
+// Asynchronous frames must render the same bytes as synchronous ones, whatever the CPU writes meanwhile
+mod common;
+use common::*;
+
+#[test]
+fn test_async_matches_sync() {
+    unsafe {
+        refsw2_cpp::init();
+
+        let sync = refsw2_cpp::create_context();
+        let background = refsw2_cpp::create_context();
+
+        // Each frame has its own VRAM, so a read outside of the snapshotted footprint sees the
+        // previous frame
+        let mut rng = Rng::new(3);
+        for index in 0..12 {
+            let frame = random_frame(&mut rng, false);
+            let expected = frame.render(sync);
+
+            let mut vram = frame.vram.clone();
+            refsw2_cpp::render_async(background, vram.as_mut_ptr(), frame.regs.as_ptr());
+
+            // the CPU keeps writing to VRAM while the frame renders
+            for word in vram.chunks_exact_mut(4) {
+                word.copy_from_slice(&rng.next().to_le_bytes());
+            }
+
+            refsw2_cpp::render_wait(background);
+            assert!(refsw2_cpp::render_poll(background));
+
+            if framebuffer(&expected) != framebuffer(&vram) {
+                panic!("frame {index}: framebuffer differs");
+            }
+        }
+
+        refsw2_cpp::destroy_context(sync);
+        refsw2_cpp::destroy_context(background);
+    }
+}
@@ -0,0 +1,450 @@
+// Synthetic frames for the refsw2 integration tests
+//
+// Parameters, object lists and the region array are written through the 32 bit VRAM area,
+// the way the TA writes them, with the registers the renderer reads.
+#![allow(dead_code)]
+
+use refsw2_cpp::RefswContext;
+
+pub const VRAM_SIZE: usize = 8 * 1024 * 1024;
+const REG_COUNT: usize = 0x8000 / 4;
+
+pub const PARAM_BASE: u32 = 0x100000;
+pub const REGION_BASE: u32 = 0x080000;
+pub const OBJECT_LISTS: u32 = 0x0C0000;
+pub const FRAMEBUFFER: u32 = 0x600000;
+
+pub const TILES_X: u32 = 6;
+pub const TILES_Y: u32 = 5;
+
+// Register offsets
+pub const PARAM_BASE_ADDR: usize = 0x20;
+pub const REGION_BASE_ADDR: usize = 0x2C;
+pub const FB_W_CTRL_ADDR: usize = 0x48;
+pub const FB_W_LINESTRIDE_ADDR: usize = 0x4C;
+pub const FB_W_SOF1_ADDR: usize = 0x60;
+pub const FB_W_SOF2_ADDR: usize = 0x64;
+pub const FPU_SHAD_SCALE_ADDR: usize = 0x74;
+pub const FPU_PARAM_CFG_ADDR: usize = 0x7C;
+pub const HALF_OFFSET_ADDR: usize = 0x80;
+pub const ISP_BACKGND_D_ADDR: usize = 0x88;
+pub const ISP_BACKGND_T_ADDR: usize = 0x8C;
+pub const ISP_FEED_CFG_ADDR: usize = 0x98;
+pub const TEXT_CONTROL_ADDR: usize = 0xE4;
+pub const SCALER_CTL_ADDR: usize = 0xF4;
+pub const PT_ALPHA_REF_ADDR: usize = 0x11C;
+
+// Object list pointers of a region array entry, in order
+pub const LIST_OPAQUE: usize = 0;
+pub const LIST_OPAQUE_MOD: usize = 1;
+pub const LIST_TRANS: usize = 2;
+pub const LIST_TRANS_MOD: usize = 3;
+pub const LIST_PUNCHT: usize = 4;
+
+pub const REGION_NO_WRITEOUT: u32 = 1 << 28;
+pub const REGION_PRE_SORT: u32 = 1 << 29;
+pub const REGION_Z_KEEP: u32 = 1 << 30;
+pub const REGION_LAST: u32 = 1 << 31;
+
+/// xorshift64*, enough to fill VRAM and pick parameters reproducibly
+pub struct Rng(u64);
+
+impl Rng {
+    pub fn new(seed: u64) -> Self {
+        Rng(seed.wrapping_mul(0x9E3779B97F4A7C15) | 1)
+    }
+
+    pub fn next(&mut self) -> u32 {
+        self.0 ^= self.0 >> 12;
+        self.0 ^= self.0 << 25;
+        self.0 ^= self.0 >> 27;
+        (self.0.wrapping_mul(0x2545F4914F6CDD1D) >> 32) as u32
+    }
+
+    pub fn below(&mut self, n: u32) -> u32 {
+        self.next() % n
+    }
+
+    pub fn float(&mut self, min: f32, max: f32) -> f32 {
+        min + (max - min) * (self.next() >> 8) as f32 / (1 << 24) as f32
+    }
+}
+
+/// Address of a 32 bit area word in the 64 bit view, as pvr_map32
+fn map32(addr: u32) -> usize {
+    let bank = (addr >> 22) & 1;
+    ((addr & 3) | ((addr & 0x3FFFFC) << 1) | (bank << 2)) as usize
+}
+
+/// Where the vertices of a polygon go, and what they carry
+pub struct Polygon {
+    pub isp: u32,
+    pub tsp: [u32; 2],
+    pub tcw: [u32; 2],
+    pub two_volumes: bool,
+}
+
+impl Polygon {
+    fn texture(&self) -> bool {
+        self.isp & (1 << 25) != 0
+    }
+
+    fn offset(&self) -> bool {
+        self.isp & (1 << 24) != 0
+    }
+
+    fn uv_16b(&self) -> bool {
+        self.isp & (1 << 22) != 0
+    }
+
+    /// Vertex words per volume after the position
+    pub fn skip(&self) -> u32 {
+        let uv = if !self.texture() {
+            0
+        } else if self.uv_16b() {
+            1
+        } else {
+            2
+        };
+        uv + 1 + self.offset() as u32
+    }
+}
+
+pub struct Frame {
+    pub vram: Vec<u8>,
+    pub regs: Vec<u32>,
+    params: u32,
+    lists: u32,
+    regions: u32,
+}
+
+impl Frame {
+    /// A frame with random VRAM and registers, and the registers the renderer depends on set up
+    pub fn new(rng: &mut Rng) -> Self {
+        let mut vram = vec![0u8; VRAM_SIZE];
+        for word in vram.chunks_exact_mut(4) {
+            word.copy_from_slice(&rng.next().to_le_bytes());
+        }
+        let regs = (0..REG_COUNT).map(|_| rng.next()).collect();
+
+        let mut frame = Frame {
+            vram,
+            regs,
+            params: PARAM_BASE,
+            lists: OBJECT_LISTS,
+            regions: REGION_BASE,
+        };
+
+        frame.regs[PARAM_BASE_ADDR / 4] = PARAM_BASE;
+        frame.regs[REGION_BASE_ADDR / 4] = REGION_BASE;
+        frame.regs[FPU_PARAM_CFG_ADDR / 4] = 1 << 21; // region array entries with a punch through list
+        frame.regs[SCALER_CTL_ADDR / 4] = 0x400;
+        frame.regs[FB_W_CTRL_ADDR / 4] = 6; // 32 bpp
+        frame.regs[FB_W_LINESTRIDE_ADDR / 4] = TILES_X * 32 * 4 / 8;
+        frame.regs[FB_W_SOF1_ADDR / 4] = FRAMEBUFFER;
+        frame.regs[FB_W_SOF2_ADDR / 4] = FRAMEBUFFER;
+        frame.regs[FPU_SHAD_SCALE_ADDR / 4] &= 0x1FF;
+        frame.regs[HALF_OFFSET_ADDR / 4] &= 7;
+        frame.regs[ISP_FEED_CFG_ADDR / 4] &= 1;
+        frame.regs[PT_ALPHA_REF_ADDR / 4] &= 255;
+        frame
+    }
+
+    pub fn write(&mut self, addr: u32, value: u32) {
+        let offset = map32(addr);
+        self.vram[offset..offset + 4].copy_from_slice(&value.to_le_bytes());
+    }
+
+    pub fn write_f32(&mut self, addr: u32, value: f32) {
+        self.write(addr, value.to_bits());
+    }
+
+    /// Whether shadowed polygons have two volumes, per FPU_SHAD_SCALE
+    pub fn two_volumes(&self) -> bool {
+        self.regs[FPU_SHAD_SCALE_ADDR / 4] & 0x100 == 0
+    }
+
+    /// Write the parameters of a polygon, with random vertex attributes. Returns the parameter
+    /// offset in words, for the object list entry or the background tag
+    pub fn polygon(&mut self, rng: &mut Rng, polygon: &Polygon, vertices: &[[f32; 3]]) -> u32 {
+        let offset = (self.params - PARAM_BASE) / 4;
+        let volumes = 1 + polygon.two_volumes as usize;
+
+        self.write(self.params, polygon.isp);
+        self.params += 4;
+        for volume in 0..volumes {
+            self.write(self.params, polygon.tsp[volume]);
+            self.write(self.params + 4, polygon.tcw[volume]);
+            self.params += 8;
+        }
+
+        for vertex in vertices {
+            for &coord in vertex {
+                self.write_f32(self.params, coord);
+                self.params += 4;
+            }
+
+            for _ in 0..volumes {
+                if polygon.texture() {
+                    if polygon.uv_16b() {
+                        self.write(self.params, rng.next());
+                        self.params += 4;
+                    } else {
+                        let (u, v) = (rng.float(-3.0, 3.0), rng.float(-3.0, 3.0));
+                        self.write_f32(self.params, u);
+                        self.write_f32(self.params + 4, v);
+                        self.params += 8;
+                    }
+                }
+                self.write(self.params, rng.next());
+                self.params += 4;
+                if polygon.offset() {
+                    self.write(self.params, rng.next());
+                    self.params += 4;
+                }
+            }
+        }
+
+        offset
+    }
+
+    /// Write the parameters of a modifier volume triangle, which only has positions. Returns the
+    /// parameter offset in words
+    pub fn volume(&mut self, isp: u32, vertices: &[[f32; 3]]) -> u32 {
+        let offset = (self.params - PARAM_BASE) / 4;
+
+        self.write(self.params, isp);
+        self.params += 12;
+        for vertex in vertices {
+            for &coord in vertex {
+                self.write_f32(self.params, coord);
+                self.params += 4;
+            }
+        }
+
+        offset
+    }
+
+    /// Write an object list, returns its address
+    pub fn list(&mut self, objects: &[u32]) -> u32 {
+        let base = self.lists;
+        for &object in objects {
+            self.write(self.lists, object);
+            self.lists += 4;
+        }
+        self.write(self.lists, (0b111 << 29) | (1 << 28));
+        self.lists += 4;
+        base
+    }
+
+    /// Append a region array entry. `control` holds the REGION_* flags
+    pub fn region(&mut self, tile_x: u32, tile_y: u32, control: u32, lists: [Option<u32>; 5]) {
+        self.write(self.regions, control | (tile_x << 2) | (tile_y << 8));
+        for (i, list) in lists.iter().enumerate() {
+            self.write(self.regions + 4 + i as u32 * 4, list.unwrap_or(0x80000000));
+        }
+        self.regions += 24;
+    }
+
+    /// Render the frame on a copy of its VRAM
+    pub fn render(&self, ctx: *mut RefswContext) -> Vec<u8> {
+        let mut vram = self.vram.clone();
+        unsafe {
+            refsw2_cpp::render_ctx(ctx, vram.as_mut_ptr(), self.regs.as_ptr());
+        }
+        vram
+    }
+}
+
+/// Strip object list entry, with the strip triangles in `mask`
+pub fn strip(offset: u32, skip: u32, shadow: bool, mask: u32) -> u32 {
+    offset | (skip << 21) | ((shadow as u32) << 24) | (mask << 25)
+}
+
+/// Triangle array object list entry, for `prims` + 1 triangles
+pub fn triangle_array(offset: u32, skip: u32, shadow: bool, prims: u32) -> u32 {
+    offset | (skip << 21) | ((shadow as u32) << 24) | (prims << 25) | (0b100 << 29)
+}
+
+/// Quad array object list entry, for `prims` + 1 quads
+pub fn quad_array(offset: u32, skip: u32, shadow: bool, prims: u32) -> u32 {
+    offset | (skip << 21) | ((shadow as u32) << 24) | (prims << 25) | (0b101 << 29)
+}
+
+/// First differing byte of two VRAM images
+pub fn first_difference(a: &[u8], b: &[u8]) -> Option<usize> {
+    a.iter().zip(b).position(|(x, y)| x != y)
+}
+
+/// The framebuffer written by a frame, as 32 bit pixels in row order
+pub fn framebuffer(vram: &[u8]) -> Vec<u32> {
+    let stride = TILES_X * 32 * 4;
+    (0..TILES_Y * 32 * TILES_X * 32)
+        .map(|pixel| {
+            let offset = map32(FRAMEBUFFER + pixel / (TILES_X * 32) * stride + pixel % (TILES_X * 32) * 4);
+            u32::from_le_bytes(vram[offset..offset + 4].try_into().unwrap())
+        })
+        .collect()
+}
+
+pub fn random_polygon(rng: &mut Rng, two_volumes: bool, list: usize, parallel: bool) -> Polygon {
+    let mut isp = rng.next() & !(1 << 21); // no cache bypass
+    if rng.below(4) == 0 {
+        isp &= !(1 << 25); // untextured
+    }
+
+    let mut polygon = Polygon { isp, tsp: [0; 2], tcw: [0; 2], two_volumes };
+
+    for volume in 0..2 {
+        let mut tsp = rng.next() & !(1 << 14); // point or bilinear filtering
+        let mut tcw = rng.next();
+        if (tcw >> 27) & 7 == 7 {
+            tcw &= !(7 << 27); // reserved pixel format
+        }
+        if rng.below(3) != 0 {
+            tcw &= !(1 << 31); // not mip mapped
+        }
+
+        if parallel {
+            // nothing carried from one region array entry to the next, see NeedsRegionOrder
+            tsp &= !(3 << 24); // SrcSelect, DstSelect
+            if (tsp >> 22) & 3 == 1 {
+                tsp ^= 3 << 22; // per vertex fog reads the offset color
+            }
+            if (tcw >> 27) & 7 == 4 {
+                tcw &= !(7 << 27); // bump maps read the offset color
+            }
+            if list == LIST_OPAQUE {
+                tsp &= !(7 << 26); // no destination color
+                tsp &= !(2 << 29);
+            }
+
+            // small textures in the first megabyte, away from the framebuffer
+            tsp &= !((1 << 2) | (1 << 5));
+            tcw &= !0x1E0000;
+        }
+
+        polygon.tsp[volume] = tsp;
+        polygon.tcw[volume] = tcw;
+    }
+
+    polygon
+}
+
+pub fn random_vertices(rng: &mut Rng, count: usize) -> Vec<[f32; 3]> {
+    let size = if rng.below(4) == 0 { 150.0 } else { 25.0 };
+    let x = rng.float(-20.0, (TILES_X * 32 + 20) as f32);
+    let y = rng.float(-20.0, (TILES_Y * 32 + 20) as f32);
+    let z = rng.float(0.01, 1.0);
+
+    (0..count)
+        .map(|_| {
+            let depth = if rng.below(4) == 0 { z } else { z * rng.float(0.5, 1.5) };
+            [x + rng.float(-size, size), y + rng.float(-size, size), depth]
+        })
+        .collect()
+}
+
+pub fn random_object(rng: &mut Rng, frame: &mut Frame, list: usize, parallel: bool) -> u32 {
+    let modifier = list == LIST_OPAQUE_MOD || list == LIST_TRANS_MOD;
+
+    if modifier {
+        // modifier volumes only have positions
+        let prims = rng.below(4);
+        let mut first = 0;
+        for prim in 0..=prims {
+            let isp = rng.next();
+            let offset = frame.volume(isp, &random_vertices(rng, 3));
+            if prim == 0 {
+                first = offset;
+            }
+        }
+        return triangle_array(first, 0, false, prims);
+    }
+
+    let shadow = rng.below(3) == 0;
+    let polygon = random_polygon(rng, shadow && frame.two_volumes(), list, parallel);
+    let skip = polygon.skip();
+
+    match rng.below(3) {
+        0 => {
+            let vertices = random_vertices(rng, 8);
+            let offset = frame.polygon(rng, &polygon, &vertices);
+            strip(offset, skip, shadow, rng.below(63) + 1)
+        }
+        1 => {
+            let vertices = random_vertices(rng, 3);
+            let offset = frame.polygon(rng, &polygon, &vertices);
+            triangle_array(offset, skip, shadow, 0)
+        }
+        _ => {
+            let vertices = random_vertices(rng, 4);
+            let offset = frame.polygon(rng, &polygon, &vertices);
+            quad_array(offset, skip, shadow, 0)
+        }
+    }
+}
+
+/// A random frame. Parallel frames avoid everything that makes the renderer fall back to the serial walk
+pub fn random_frame(rng: &mut Rng, parallel: bool) -> Frame {
+    let mut frame = Frame::new(rng);
+
+    if parallel {
+        frame.regs[TEXT_CONTROL_ADDR / 4] &= !31;
+    }
+
+    let depth = rng.float(0.0, 0.01);
+    frame.regs[ISP_BACKGND_D_ADDR / 4] = depth.to_bits();
+
+    // background polygon, untextured
+    let mut tsp = rng.next();
+    if parallel {
+        tsp = (tsp & 0x003FFFFF) | (1 << 29) | (2 << 22); // overwrite the color buffer, no fog
+    }
+    let background = Polygon { isp: 0, tsp: [tsp, 0], tcw: [rng.next(), 0], two_volumes: false };
+    let vertices = [[0.0, 0.0, depth], [640.0, 0.0, depth], [0.0, 480.0, depth]];
+    let offset = frame.polygon(rng, &background, &vertices);
+    frame.regs[ISP_BACKGND_T_ADDR / 4] = (offset << 3) | (1 << 24);
+
+    let max_objects = [12, 3, 10, 2, 6];
+    let mut lists = [None; 5];
+    for list in 0..5 {
+        let count = rng.below(max_objects[list] + 1);
+        let objects: Vec<u32> = (0..count).map(|_| random_object(rng, &mut frame, list, parallel)).collect();
+        if !objects.is_empty() {
+            lists[list] = Some(frame.list(&objects));
+        }
+    }
+
+    for tile_y in 0..TILES_Y {
+        for tile_x in 0..TILES_X {
+            let passes = if rng.below(5) == 0 { 2 } else { 1 };
+            for pass in 0..passes {
+                let mut control = 0;
+                if rng.below(2) == 0 {
+                    control |= REGION_PRE_SORT;
+                }
+                // parallel frames only keep the buffers of the same tile position
+                if rng.below(2) == 0 && (pass > 0 || (!parallel && rng.below(4) == 0)) {
+                    control |= REGION_Z_KEEP;
+                }
+                if pass + 1 < passes {
+                    control |= REGION_NO_WRITEOUT;
+                }
+                if tile_y == TILES_Y - 1 && tile_x == TILES_X - 1 && pass + 1 == passes {
+                    control |= REGION_LAST;
+                }
+
+                let mut entry_lists = lists;
+                for list in entry_lists.iter_mut() {
+                    if rng.below(6) == 0 {
+                        *list = None;
+                    }
+                }
+                frame.region(tile_x, tile_y, control, entry_lists);
+            }
+        }
+    }
+
+    frame
+}
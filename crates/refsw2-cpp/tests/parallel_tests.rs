@@ -0,0 +1,91 @@
+// Tile workers must render the same bytes as the serial walk, frame after frame
+mod common;
+use common::*;
+
+const RENDER_THREADS: u32 = 4;
+
+#[test]
+fn test_threads_match_serial() {
+    unsafe {
+        refsw2_cpp::init();
+
+        for seed in 0..4 {
+            let serial = refsw2_cpp::create_context();
+            let threaded = refsw2_cpp::create_context();
+            refsw2_cpp::set_threads_ctx(serial, 1);
+            refsw2_cpp::set_threads_ctx(threaded, RENDER_THREADS);
+
+            // Serial and parallel frames interleave, so each starts from the tile state the other left
+            let mut rng = Rng::new(seed);
+            for index in 0..8 {
+                let frame = random_frame(&mut rng, index % 3 != 2);
+
+                let expected = frame.render(serial);
+                let actual = frame.render(threaded);
+                if let Some(offset) = first_difference(&expected, &actual) {
+                    panic!("seed {seed} frame {index}: VRAM differs at {offset:#x}");
+                }
+            }
+
+            refsw2_cpp::destroy_context(serial);
+            refsw2_cpp::destroy_context(threaded);
+        }
+    }
+}
+
+/// A frame where every tile is covered by a single opaque triangle
+fn covered_frame(rng: &mut Rng, polygon: &Polygon) -> Frame {
+    let mut frame = Frame::new(rng);
+    frame.regs[TEXT_CONTROL_ADDR / 4] &= !31;
+    frame.regs[ISP_BACKGND_D_ADDR / 4] = 0.0f32.to_bits();
+
+    let background = Polygon { isp: 0, tsp: [(1 << 29) | (2 << 22), 0], tcw: [0; 2], two_volumes: false };
+    let offset = frame.polygon(rng, &background, &[[0.0, 0.0, 0.0], [640.0, 0.0, 0.0], [0.0, 480.0, 0.0]]);
+    frame.regs[ISP_BACKGND_T_ADDR / 4] = (offset << 3) | (1 << 24);
+
+    let (width, height) = ((TILES_X * 64) as f32, (TILES_Y * 64) as f32);
+    let offset = frame.polygon(rng, polygon, &[[-1.0, -1.0, 0.5], [width, -1.0, 0.5], [-1.0, height, 0.5]]);
+    let opaque = frame.list(&[triangle_array(offset, polygon.skip(), false, 0)]);
+
+    for tile_y in 0..TILES_Y {
+        for tile_x in 0..TILES_X {
+            let last = if tile_y == TILES_Y - 1 && tile_x == TILES_X - 1 { REGION_LAST } else { 0 };
+            frame.region(tile_x, tile_y, last, [Some(opaque), None, None, None, None]);
+        }
+    }
+
+    frame
+}
+
+#[test]
+fn test_threads_carry_offset_color() {
+    unsafe {
+        refsw2_cpp::init();
+
+        let serial = refsw2_cpp::create_context();
+        let threaded = refsw2_cpp::create_context();
+        refsw2_cpp::set_threads_ctx(serial, 1);
+        refsw2_cpp::set_threads_ctx(threaded, RENDER_THREADS);
+
+        // depth always, textured, with offset color / without it
+        let isp = (7 << 29) | (1 << 25);
+        let tsp = (1 << 29) | (2 << 22); // one * source, no fog
+        let offset_color = Polygon { isp: isp | (1 << 24), tsp: [tsp, 0], tcw: [(1 << 27) | 0x1000, 0], two_volumes: false };
+        let bump_map = Polygon { isp, tsp: [tsp, 0], tcw: [(4 << 27) | 0x1000, 0], two_volumes: false };
+
+        // The offset color written by the tile workers is what the bump map reads next
+        let mut rng = Rng::new(1);
+        for (index, polygon) in [&offset_color, &bump_map].into_iter().enumerate() {
+            let frame = covered_frame(&mut rng, polygon);
+
+            let expected = frame.render(serial);
+            let actual = frame.render(threaded);
+            if let Some(offset) = first_difference(&expected, &actual) {
+                panic!("frame {index}: VRAM differs at {offset:#x}");
+            }
+        }
+
+        refsw2_cpp::destroy_context(serial);
+        refsw2_cpp::destroy_context(threaded);
+    }
+}
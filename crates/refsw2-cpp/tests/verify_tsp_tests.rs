@@ -0,0 +1,209 @@
+// The vector TSP pipeline must match the scalar one span for span, see REFSW_VERIFY_TSP
+#![cfg(feature = "verify-tsp")]
+
+mod common;
+use common::*;
+
+// ISP/TSP instruction word
+const DEPTH_ALWAYS: u32 = 7 << 29;
+const TEXTURE: u32 = 1 << 25;
+const OFFSET: u32 = 1 << 24;
+
+// TSP instruction word
+const SRC_SELECT: u32 = 1 << 25;
+const DST_SELECT: u32 = 1 << 24;
+const FOG_LOOKUP: u32 = 0b00 << 22;
+const FOG_VERTEX: u32 = 0b01 << 22;
+const FOG_NONE: u32 = 0b10 << 22;
+const FOG_LOOKUP_2: u32 = 0b11 << 22;
+const COLOR_CLAMP: u32 = 1 << 21;
+const USE_ALPHA: u32 = 1 << 20;
+const SRC_ONE: u32 = 1 << 29;
+
+// Texture control word
+const BUMP_MAP: u32 = 4 << 27;
+
+const FRAMES: u64 = 6;
+
+/// Polygons of one pipeline state, with the other state bits random
+struct Case {
+    name: &'static str,
+    list: usize,
+    states: &'static [(u32, u32)], // ISP/TSP bits, TSP bits
+}
+
+const CASES: &[Case] = &[
+    Case { name: "textured with offset, lookup fog", list: LIST_OPAQUE, states: &[(TEXTURE | OFFSET, FOG_LOOKUP)] },
+    Case { name: "textured with offset, vertex fog", list: LIST_OPAQUE, states: &[(TEXTURE | OFFSET, FOG_VERTEX)] },
+    Case { name: "untextured with offset, vertex fog", list: LIST_OPAQUE, states: &[(OFFSET, FOG_VERTEX)] },
+    Case { name: "lookup fog mode 2", list: LIST_TRANS, states: &[(TEXTURE, FOG_LOOKUP_2), (OFFSET, FOG_LOOKUP_2)] },
+    Case { name: "color clamp", list: LIST_OPAQUE, states: &[(TEXTURE | OFFSET, COLOR_CLAMP | FOG_NONE), (0, COLOR_CLAMP | FOG_LOOKUP)] },
+    Case { name: "alpha test", list: LIST_PUNCHT, states: &[(TEXTURE, USE_ALPHA | FOG_NONE), (TEXTURE | OFFSET, USE_ALPHA | FOG_LOOKUP)] },
+    Case {
+        name: "secondary accumulation buffer",
+        list: LIST_TRANS,
+        states: &[(TEXTURE, DST_SELECT | FOG_NONE), (TEXTURE | OFFSET, SRC_SELECT | FOG_NONE), (0, SRC_SELECT | DST_SELECT | FOG_NONE)],
+    },
+];
+
+/// Random TSP bits, other than the ones a case sets
+fn random_tsp(rng: &mut Rng) -> u32 {
+    let cleared = (1 << 14) | SRC_SELECT | DST_SELECT | (3 << 22) | COLOR_CLAMP | USE_ALPHA;
+    rng.next() & !cleared
+}
+
+fn random_tcw(rng: &mut Rng) -> u32 {
+    let mut tcw = rng.next();
+    if matches!((tcw >> 27) & 7, 4 | 7) {
+        tcw &= !(7 << 27); // bump maps are scalar only, 7 is reserved
+    }
+    tcw
+}
+
+/// A frame with `triangles` random triangles per state of the case
+fn case_frame(rng: &mut Rng, case: &Case, triangles: u32) -> Frame {
+    let mut frame = Frame::new(rng);
+    frame.regs[ISP_BACKGND_D_ADDR / 4] = 0.0f32.to_bits();
+
+    // The background is bump mapped, which only the scalar pipeline does, so every span checked
+    // belongs to a polygon of the case
+    let background = Polygon { isp: TEXTURE, tsp: [SRC_ONE | FOG_NONE, 0], tcw: [BUMP_MAP | rng.next() & 0x1FFFFF, 0], two_volumes: false };
+    let offset = frame.polygon(rng, &background, &[[0.0, 0.0, 0.0], [640.0, 0.0, 0.0], [0.0, 480.0, 0.0]]);
+    frame.regs[ISP_BACKGND_T_ADDR / 4] = (offset << 3) | (background.skip() << 24);
+
+    let mut objects = Vec::new();
+    for &(isp, tsp) in case.states {
+        for _ in 0..triangles {
+            let polygon = Polygon {
+                isp: DEPTH_ALWAYS | isp | (rng.next() & (3 << 22)), // UV_16b, Gouraud
+                tsp: [random_tsp(rng) | tsp, 0],
+                tcw: [random_tcw(rng), 0],
+                two_volumes: false,
+            };
+
+            let size = rng.float(8.0, 150.0);
+            let x = rng.float(0.0, (TILES_X * 32) as f32);
+            let y = rng.float(0.0, (TILES_Y * 32) as f32);
+            let z = rng.float(0.1, 1.0);
+            let vertices: Vec<[f32; 3]> = (0..3).map(|_| [x + rng.float(-size, size), y + rng.float(-size, size), z]).collect();
+
+            let offset = frame.polygon(rng, &polygon, &vertices);
+            objects.push(triangle_array(offset, polygon.skip(), false, 0));
+        }
+    }
+
+    let mut lists = [None; 5];
+    lists[case.list] = Some(frame.list(&objects));
+
+    for tile_y in 0..TILES_Y {
+        for tile_x in 0..TILES_X {
+            let mut control = if rng.below(2) == 0 { REGION_PRE_SORT } else { 0 };
+            if tile_y == TILES_Y - 1 && tile_x == TILES_X - 1 {
+                control |= REGION_LAST;
+            }
+            frame.region(tile_x, tile_y, control, lists);
+        }
+    }
+
+    frame
+}
+
+#[test]
+fn test_vector_tsp_matches_scalar() {
+    unsafe {
+        refsw2_cpp::init();
+        let ctx = refsw2_cpp::create_context();
+
+        for (index, case) in CASES.iter().enumerate() {
+            let mut rng = Rng::new(index as u64);
+            let mut spans = 0;
+
+            for _ in 0..FRAMES {
+                let frame = case_frame(&mut rng, case, 4);
+                frame.render(ctx);
+
+                let (verified, mismatches) = refsw2_cpp::verify_stats(ctx);
+                assert_eq!(mismatches, 0, "{}", case.name);
+                spans += verified;
+            }
+
+            assert!(spans > 0, "{}: no span went through the vector pipeline", case.name);
+        }
+
+        refsw2_cpp::destroy_context(ctx);
+    }
+}
+
+/// Spans of the first tile, as (x0, x1). Vector lanes are grouped by 8 pixels, these start and end
+/// inside a group, cover a single pixel, or cross one or more groups
+const SPANS: &[(u32, u32)] = &[(3, 12), (9, 14), (17, 17), (5, 29), (0, 7), (24, 30), (1, 30), (8, 23)];
+const SPAN_ROWS: u32 = 2;
+
+/// A frame with a rectangle per span of SPANS, each covering SPAN_ROWS rows of the first tile
+fn span_frame(rng: &mut Rng, list: usize) -> Frame {
+    let mut frame = Frame::new(rng);
+    frame.regs[ISP_BACKGND_D_ADDR / 4] = 0.0f32.to_bits();
+
+    let background = Polygon { isp: TEXTURE, tsp: [SRC_ONE | FOG_NONE, 0], tcw: [BUMP_MAP | rng.next() & 0x1FFFFF, 0], two_volumes: false };
+    let offset = frame.polygon(rng, &background, &[[0.0, 0.0, 0.0], [640.0, 0.0, 0.0], [0.0, 480.0, 0.0]]);
+    frame.regs[ISP_BACKGND_T_ADDR / 4] = (offset << 3) | (background.skip() << 24);
+
+    let mut objects = Vec::new();
+    for (i, &(x0, x1)) in SPANS.iter().enumerate() {
+        // the offset color left in the tile comes from the last pixel of the span
+        let isp = if i % 4 == 3 { OFFSET } else { TEXTURE | OFFSET };
+        let mut tsp = random_tsp(rng) | (rng.next() & ((3 << 22) | COLOR_CLAMP | USE_ALPHA));
+        if list == LIST_TRANS {
+            tsp |= rng.next() & (SRC_SELECT | DST_SELECT);
+        }
+
+        let polygon = Polygon {
+            isp: DEPTH_ALWAYS | isp | (rng.next() & (3 << 22)),
+            tsp: [tsp, 0],
+            tcw: [random_tcw(rng), 0],
+            two_volumes: false,
+        };
+
+        // edges between pixel centers, for either sampling offset
+        let (left, right) = (x0 as f32 - 0.25, x1 as f32 + 0.75);
+        let (top, bottom) = ((i as u32 * SPAN_ROWS) as f32 - 0.25, ((i as u32 + 1) * SPAN_ROWS) as f32 - 0.25);
+        let z = rng.float(0.1, 1.0);
+        // corners counter-clockwise on screen
+        let vertices = [[left, top, z], [left, bottom, z * 0.5], [right, bottom, z], [right, top, z]];
+
+        let offset = frame.polygon(rng, &polygon, &vertices);
+        objects.push(quad_array(offset, polygon.skip(), false, 0));
+    }
+
+    let mut lists = [None; 5];
+    lists[list] = Some(frame.list(&objects));
+    frame.region(0, 0, REGION_LAST | if rng.below(2) == 0 { REGION_PRE_SORT } else { 0 }, lists);
+
+    frame
+}
+
+#[test]
+fn test_vector_tsp_partial_spans() {
+    unsafe {
+        refsw2_cpp::init();
+        let ctx = refsw2_cpp::create_context();
+        let expected = SPANS.len() as u64 * SPAN_ROWS as u64;
+
+        for (seed, list) in [LIST_OPAQUE, LIST_PUNCHT, LIST_TRANS].into_iter().cycle().take(24).enumerate() {
+            let mut rng = Rng::new(seed as u64);
+            let frame = span_frame(&mut rng, list);
+            frame.render(ctx);
+
+            // Opaque spans are shaded once, the other lists may take more passes
+            let (spans, mismatches) = refsw2_cpp::verify_stats(ctx);
+            assert_eq!(mismatches, 0, "seed {seed}");
+            if list == LIST_OPAQUE {
+                assert_eq!(spans, expected, "seed {seed}");
+            } else {
+                assert!(spans >= expected, "seed {seed}: {spans} spans checked");
+            }
+        }
+
+        refsw2_cpp::destroy_context(ctx);
+    }
+}